@@ -0,0 +1,76 @@
+// SPDX-License-Identifier: MIT
+/*!
+ * \file explorer.c
+ * \details Benchmarks the reachable-configuration explorer's scaling across
+ * threads. Six regions, each a ring of ten states, combine into a million
+ * reachable configurations.
+ */
+
+#include "infinite_state_explorer.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#define REGIONS 6
+#define RING 10
+
+struct topology {
+  struct infinite_state ring[REGIONS * RING];
+};
+
+static struct topology topology;
+
+static double seconds(void) {
+  struct timespec now;
+  timespec_get(&now, TIME_UTC);
+  return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+int bench_explorer(int argc, char *argv[]) {
+  static const struct infinite_state *states[REGIONS * RING];
+  static const struct infinite_state *initial[REGIONS];
+  static struct infinite_state_explorer_transition steps[REGIONS * RING];
+#if INFINITE_STATE_REF_BITS
+  infinite_state_base = &topology;
+#endif
+  for (int i = 0; i < REGIONS * RING; i++) {
+    int region = i / RING;
+    states[i] = &topology.ring[i];
+    steps[i] = (struct infinite_state_explorer_transition){
+        region, &topology.ring[i],
+        &topology.ring[region * RING + (i + 1) % RING]};
+  }
+  for (int region = 0; region < REGIONS; region++)
+    initial[region] = &topology.ring[region * RING];
+  struct infinite_state_explorer explorer = {
+      .states = states,
+      .count = REGIONS * RING,
+      .depth = 1,
+      .regions = REGIONS,
+      .initial = initial,
+      .transitions = steps,
+      .transitioned = REGIONS * RING,
+      .capacity = 1000000};
+  int cores = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  printf("%8s %14s %14s %16s\n", "threads", "configurations", "transitions",
+         "ns/configuration");
+  for (int threads = 1;; threads *= 2) {
+    if (threads > cores)
+      threads = cores;
+    explorer.threads = threads;
+    struct infinite_state_exploration exploration;
+    double start = seconds();
+    int err = infinite_state_explore(&explorer, &exploration);
+    double elapsed = seconds() - start;
+    assert(err == 0);
+    assert(exploration.configurations == 1000000);
+    printf("%8d %14zu %14zu %16.1f\n", threads, exploration.configurations,
+           exploration.transitions, elapsed * 1e9 / exploration.configurations);
+    infinite_state_exploration_free(&exploration);
+    if (threads == cores)
+      break;
+  }
+  return 0;
+}
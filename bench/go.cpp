@@ -0,0 +1,63 @@
+// SPDX-License-Identifier: MIT
+//! \file go.cpp
+//! \details Benchmarks the C++ state machine's go() across a sweep of
+//! hierarchy depths. A path-like topology nests each state within the previous
+//! one; the deepest state has a sibling. Hopping between the two siblings
+//! should cost the same at every depth since their least common ancestor sits
+//! immediately above them. With a sealed index, finding the ancestor costs
+//! O(log d) instead.
+
+#include "infinite_state_machine.hpp"
+
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+struct node : infinite::state<node> {};
+
+static double nanoseconds(std::chrono::steady_clock::duration duration) {
+  return std::chrono::duration<double, std::nano>(duration).count();
+}
+
+extern "C" int bench_go(int argc, char *argv[]) {
+  static const int depths[] = {8, 64, 512, 4096, 32768, 100000};
+  static const int hops = 100000;
+  std::printf("%8s %14s %14s %14s\n", "depth", "ns/deep-go", "ns/sibling-go",
+              "ns/indexed-go");
+  for (int depth : depths) {
+    std::vector<node> nodes(depth + 1);
+    nodes[0].super = nullptr;
+    for (int i = 1; i < depth; i++)
+      nodes[i].super = &nodes[i - 1];
+    // The sibling of the deepest state.
+    nodes[depth].super = &nodes[depth - 2];
+    infinite::state_machine<node> machine;
+    auto start = std::chrono::steady_clock::now();
+    machine.go(&nodes[depth - 1]);
+    auto deep = std::chrono::steady_clock::now() - start;
+    start = std::chrono::steady_clock::now();
+    for (int hop = 0; hop < hops; hop++) {
+      machine.go(&nodes[depth]);
+      machine.go(&nodes[depth - 1]);
+    }
+    auto sibling = std::chrono::steady_clock::now() - start;
+    assert(machine.at() == &nodes[depth - 1]);
+    assert(machine.in(&nodes[0]));
+    // Hop between the siblings again, this time with a sealed index.
+    infinite::state_index<node> index{&nodes[depth - 1], &nodes[depth]};
+    infinite::state_machine<node> indexed(&index);
+    indexed.go(&nodes[depth - 1]);
+    start = std::chrono::steady_clock::now();
+    for (int hop = 0; hop < hops; hop++) {
+      indexed.go(&nodes[depth]);
+      indexed.go(&nodes[depth - 1]);
+    }
+    auto lifted = std::chrono::steady_clock::now() - start;
+    assert(indexed.at() == &nodes[depth - 1]);
+    std::printf("%8d %14.1f %14.1f %14.1f\n", depth, nanoseconds(deep),
+                nanoseconds(sibling) / (2 * hops),
+                nanoseconds(lifted) / (2 * hops));
+  }
+  return 0;
+}
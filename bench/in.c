@@ -0,0 +1,81 @@
+// SPDX-License-Identifier: MIT
+/*!
+ * \file in.c
+ * \details Benchmarks the C engine's per-call cost of querying and
+ * transitioning a machine. Built as is, every call crosses into the library.
+ * Built again by inline.c, through the single-header amalgamation, the same
+ * calls inline at the call site. Compare the two with an optimised build.
+ */
+
+#include "infinite_state_machine.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <time.h>
+
+#ifndef BENCH_IN
+#define BENCH_IN bench_in
+#define BENCH_IN_NAME "out-of-line"
+#endif
+
+/*
+ * Two siblings within an outer state, and an unrelated state.
+ */
+struct topology {
+  struct infinite_state outer, left, right, other;
+};
+
+static struct topology topology = {
+    .left.super = INFINITE_STATE_REF_OF(struct topology, topology, outer),
+    .right.super = INFINITE_STATE_REF_OF(struct topology, topology, outer),
+};
+
+static INFINITE_STATE_MACHINE(machine, 2);
+
+static volatile int sink;
+
+static double nanoseconds(void) {
+  struct timespec now;
+  timespec_get(&now, TIME_UTC);
+  return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+int BENCH_IN(int argc, char *argv[]) {
+  static const int calls = 10000000;
+  const struct infinite_state *states[] = {&topology.outer, &topology.left,
+                                           &topology.right, &topology.other};
+#if INFINITE_STATE_REF_BITS
+  infinite_state_base = &topology;
+#endif
+  infinite_state_machine_init(&machine.machine);
+  infinite_state_machine_goto(&machine.machine, &topology.left);
+  /*
+   * Cycle the queried state so that the compiler cannot hoist an inlined
+   * query out of the loop.
+   */
+  int count = 0;
+  double start = nanoseconds();
+  for (int call = 0; call < calls; call++) {
+    count += infinite_state_machine_in(&machine.machine, states[call & 3]);
+  }
+  double in = nanoseconds() - start;
+  assert(count == calls / 2);
+  sink = count;
+  start = nanoseconds();
+  for (int call = 0; call < calls; call++) {
+    count += infinite_state_machine_top(&machine.machine) == states[call & 3];
+  }
+  double top = nanoseconds() - start;
+  sink = count;
+  start = nanoseconds();
+  for (int call = 0; call < calls; call += 2) {
+    infinite_state_machine_goto(&machine.machine, &topology.right);
+    infinite_state_machine_goto(&machine.machine, &topology.left);
+  }
+  double go = nanoseconds() - start;
+  assert(infinite_state_machine_top(&machine.machine) == &topology.left);
+  printf("%-12s %10s %10s %10s\n", "calls", "ns/in", "ns/top", "ns/goto");
+  printf("%-12s %10.2f %10.2f %10.2f\n", BENCH_IN_NAME, in / calls,
+         top / calls, go / calls);
+  return 0;
+}
@@ -0,0 +1,12 @@
+// SPDX-License-Identifier: MIT
+/*!
+ * \file inline.c
+ * \details Builds the in.c benchmark against the single-header amalgamation
+ * so that every engine call inlines.
+ */
+
+#include "infinite_state_machine_amalgamation.h"
+
+#define BENCH_IN bench_inline
+#define BENCH_IN_NAME "inline"
+#include "in.c"
@@ -0,0 +1,99 @@
+// SPDX-License-Identifier: MIT
+/*!
+ * \file realtime.c
+ * \details Benchmarks the latency jitter of a real-time controller's
+ * transitions against their worst-case steps. Reports the analysed worst case
+ * of going to each state, then times every transition of a repeating control
+ * cycle: minimum, mean, 99th percentile and maximum, and the jitter between
+ * the extremes. Locks memory and runs at FIFO priority where permitted; run
+ * with the privilege for meaningful maxima.
+ */
+
+#define _GNU_SOURCE
+
+#include "infinite_state_machine.h"
+#include "infinite_state_wcet.h"
+
+#include <assert.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#define SAMPLES 1000000
+#define BUCKETS 100000
+
+/*
+ * Stopped, starting with its initial igniting and then cranking sub-states,
+ * and running.
+ */
+struct topology {
+  struct infinite_state stopped, starting, igniting, cranking, running;
+};
+
+static struct topology topology = {
+    .starting.initial = INFINITE_STATE_REF_OF(struct topology, topology, igniting),
+    .igniting.super = INFINITE_STATE_REF_OF(struct topology, topology, starting),
+    .cranking.super = INFINITE_STATE_REF_OF(struct topology, topology, starting),
+};
+
+static INFINITE_STATE_MACHINE(controller, 2);
+
+/*
+ * Latencies in nanoseconds, the last bucket collecting any longer.
+ */
+static uint32_t histogram[BUCKETS];
+
+static const char *name(const void *state) {
+  static const char *const names[] = {"stopped", "starting", "igniting",
+                                      "cranking", "running"};
+  return names[(const struct infinite_state *)state - &topology.stopped];
+}
+
+static int64_t nanoseconds(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+int bench_realtime(int argc, char *argv[]) {
+  const struct infinite_state *const states[] = {
+      &topology.stopped, &topology.starting, &topology.igniting,
+      &topology.cranking, &topology.running};
+  const struct infinite_state *const cycle[] = {
+      &topology.starting, &topology.cranking, &topology.running,
+      &topology.stopped};
+#if INFINITE_STATE_REF_BITS
+  infinite_state_base = &topology;
+#endif
+  int worst = infinite_state_wcet_report(stdout, states, 5, 2, name);
+  assert(worst == 3);
+  (void)mlockall(MCL_CURRENT | MCL_FUTURE);
+  struct sched_param param = {.sched_priority = sched_get_priority_max(SCHED_FIFO)};
+  int fifo = sched_setscheduler(0, SCHED_FIFO, &param) == 0;
+  infinite_state_machine_init(&controller.machine);
+  infinite_state_machine_goto(&controller.machine, &topology.stopped);
+  int64_t min = INT64_MAX, max = 0, sum = 0;
+  for (int sample = 0; sample < SAMPLES; sample++) {
+    int64_t start = nanoseconds();
+    infinite_state_machine_goto(&controller.machine, cycle[sample & 3]);
+    int64_t latency = nanoseconds() - start;
+    min = latency < min ? latency : min;
+    max = latency > max ? latency : max;
+    sum += latency;
+    histogram[latency < BUCKETS ? latency : BUCKETS - 1]++;
+  }
+  assert(infinite_state_machine_top(&controller.machine) == &topology.stopped);
+  int64_t p99 = 0;
+  for (uint32_t below = 0; p99 < BUCKETS; p99++) {
+    if ((below += histogram[p99]) >= SAMPLES / 100 * 99)
+      break;
+  }
+  printf("%-10s %8s %8s %8s %8s %8s\n", "goto", "ns/min", "ns/mean", "ns/p99",
+         "ns/max", "jitter");
+  printf("%-10s %8lld %8.1f %8lld %8lld %8lld\n", fifo ? "fifo" : "other",
+         (long long)min, (double)sum / SAMPLES, (long long)p99,
+         (long long)max, (long long)(max - min));
+  return 0;
+}
@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: MIT
+/*!
+ * \file simulator.c
+ * \details Benchmarks the discrete-event simulator's throughput in simulated
+ * machine-hours per wall-clock minute. Each machine toggles between two states
+ * on a timeout of about a second, in virtual milliseconds, for one virtual
+ * hour.
+ */
+
+#include "infinite_state_simulator.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <time.h>
+
+#define MACHINES 10000
+
+static void toggle(struct infinite_state_simulator *simulator,
+                   const struct infinite_state_simulator_event *event);
+
+struct topology {
+  struct infinite_state on, off;
+};
+
+static struct topology topology;
+
+static INFINITE_STATE_MACHINE_TYPE(1) machines[MACHINES];
+
+static struct infinite_state_simulator_event events[MACHINES];
+
+static void toggle(struct infinite_state_simulator *simulator,
+                   const struct infinite_state_simulator_event *event) {
+  const struct infinite_state *to =
+      event->state == &topology.on ? &topology.off : &topology.on;
+  infinite_state_machine_goto(event->machine, to);
+  /*
+   * A deterministic jitter keeps the machines from firing in lockstep.
+   */
+  uint64_t timeout = 1000 + (uintptr_t)event->context % 97;
+  infinite_state_simulator_schedule(simulator, timeout, event->machine, to,
+                                    toggle, event->context);
+}
+
+static double seconds(void) {
+  struct timespec now;
+  timespec_get(&now, TIME_UTC);
+  return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+int bench_simulator(int argc, char *argv[]) {
+  static const uint64_t hour = 60 * 60 * 1000;
+#if INFINITE_STATE_REF_BITS
+  infinite_state_base = &topology;
+#endif
+  struct infinite_state_simulator simulator;
+  infinite_state_simulator_init(&simulator, events, MACHINES);
+  for (uintptr_t i = 0; i < MACHINES; i++) {
+    infinite_state_machine_init_depth(&machines[i].machine, 1);
+    infinite_state_machine_goto(&machines[i].machine, &topology.on);
+    infinite_state_simulator_schedule(&simulator, i % 1000,
+                                      &machines[i].machine, &topology.on,
+                                      toggle, (void *)i);
+  }
+  double start = seconds();
+  uint64_t fired = infinite_state_simulator_run(&simulator, hour);
+  double elapsed = seconds() - start;
+  assert(simulator.now == hour);
+  printf("%10s %12s %14s %18s\n", "machines", "events", "ns/event",
+         "machine-hours/min");
+  printf("%10d %12llu %14.1f %18.0f\n", MACHINES, (unsigned long long)fired,
+         elapsed * 1e9 / fired, MACHINES / elapsed * 60);
+  return 0;
+}
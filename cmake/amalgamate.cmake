@@ -0,0 +1,69 @@
+# SPDX-License-Identifier: MIT
+#
+# Concatenates the C engine's headers and sources into a single header with
+# static inline definitions. Run as a script:
+#
+#   cmake -DSOURCE_DIR=<repository> -DOUTPUT=<header> -P amalgamate.cmake
+#
+# Includes of amalgamated headers disappear; everything else passes through
+# unchanged. The amalgamation covers the core engine only: the optional
+# profiler, counters, coverage and deferral live in the library, so the
+# generated header refuses to compile with their macros defined.
+
+set(amalgamated
+    inc/infinite_state_probe.h
+    inc/infinite_state.h
+    inc/infinite_state_machine.h
+    src/infinite_state.c
+    src/infinite_state_machine.c
+)
+
+set(header [=[/*
+ * SPDX-FileCopyrightText: 2023, Roy Ratcliffe, Northumberland, United Kingdom
+ * SPDX-License-Identifier: MIT
+ */
+/*!
+ * \file infinite_state_machine_amalgamation.h
+ * \brief Single-header amalgamation of the C engine.
+ * Generated from the library sources; do not edit. Include this header instead
+ * of \c{infinite_state_machine.h} in C translation units, before any other
+ * engine header. Every public function becomes \c{static inline}, so that
+ * queries such as \c{infinite_state_machine_in()} inline at the call site
+ * without link-time optimisation.
+ *
+ * With compressed state references, exactly one translation unit defines
+ * \c{infinite_state_base}.
+ *
+ * The amalgamation covers the core engine only. The profiler, counters,
+ * coverage and deferral hooks would call into the library, and deferral
+ * changes the machine's layout, so none of their macros may be defined; link
+ * the library instead to use them.
+ */
+
+#ifndef INFINITE_STATE_MACHINE_AMALGAMATION_H
+#define INFINITE_STATE_MACHINE_AMALGAMATION_H
+
+#define INFINITE_STATE_AMALGAMATION
+#define INFINITE_STATE_API static inline
+
+#if defined(INFINITE_STATE_PROFILE) || defined(INFINITE_STATE_COUNTER) || defined(INFINITE_STATE_COVERAGE) ||      \
+    defined(INFINITE_STATE_DEFER)
+#error "the amalgamation covers the core engine only; link the library for profiling, counters, coverage or deferral"
+#endif
+]=])
+
+foreach(file IN LISTS amalgamated)
+    file(READ ${SOURCE_DIR}/${file} content)
+    foreach(include IN LISTS amalgamated)
+        get_filename_component(name ${include} NAME)
+        string(REPLACE "#include \"${name}\"\n" "" content "${content}")
+    endforeach()
+    string(APPEND header "\n/* ${file} */\n\n${content}")
+endforeach()
+
+string(APPEND header "\n#endif /* INFINITE_STATE_MACHINE_AMALGAMATION_H */\n")
+
+# Leave an unchanged header alone so that its dependents do not rebuild.
+file(WRITE ${OUTPUT}.tmp "${header}")
+file(COPY_FILE ${OUTPUT}.tmp ${OUTPUT} ONLY_IF_DIFFERENT)
+file(REMOVE ${OUTPUT}.tmp)
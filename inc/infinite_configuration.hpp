@@ -0,0 +1,196 @@
+// SPDX-License-Identifier: MIT
+//! \file infinite_configuration.hpp
+//! \details This file contains hash-consed (interned) configurations of active
+//! states, shared by any number of state machines. Each machine holds a single
+//! pointer to an immutable configuration; transitions between configurations
+//! are memoised.
+
+#ifndef INFINITE_CONFIGURATION_HPP_
+#define INFINITE_CONFIGURATION_HPP_
+
+#include "infinite_state_machine.hpp"
+
+// for stable configuration addresses
+#include <deque>
+
+// for interning and memoisation
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace infinite {
+
+template <typename Topology> class configuration_pool;
+template <typename Topology> class shared_state_machine;
+
+//! \brief An interned, immutable configuration of active states.
+//! \details A configuration is its innermost active state nested within its
+//! super-configuration, the same configuration less the innermost state. The
+//! configurations therefore form a prefix tree rooted at the empty
+//! configuration. The pool interns each (super-configuration, state) pair
+//! exactly once, so equal configurations share the same address.
+template <typename Topology> class configuration {
+public:
+  using size_type = std::size_t;
+
+  //! \brief Get the innermost active state.
+  //! \return The current state, or \c nullptr for the empty configuration.
+  state<Topology> *at() const { return top; }
+
+  //! \brief Check if a state is active.
+  //! \param state The state to check.
+  //! \return Answers \c true if the state is active, \c false otherwise.
+  //! \note O(n) time complexity applies, where n is the depth.
+  bool in(state<Topology> *state) const {
+    for (auto config = this; config->super; config = config->super)
+      if (config->top == state)
+        return true;
+    return false;
+  }
+
+  //! \brief Get the number of active states.
+  size_type depth() const { return size; }
+
+private:
+  friend class configuration_pool<Topology>;
+  friend class shared_state_machine<Topology>;
+
+  configuration(configuration_pool<Topology> *pool, const configuration *super,
+                state<Topology> *top)
+      : pool(pool), super(super), top(top),
+        size(super ? super->size + 1 : 0) {}
+
+  configuration_pool<Topology> *pool;
+  const configuration *super;
+  state<Topology> *top;
+  size_type size;
+
+  //! \brief Interned sub-configurations by innermost state.
+  mutable std::unordered_map<state<Topology> *, const configuration *> subs;
+
+  //! \brief Memoised transitions by new state.
+  mutable std::unordered_map<
+      state<Topology> *,
+      std::pair<const configuration *,
+                typename state_machine<Topology>::transition>>
+      gos;
+};
+
+//! \brief Owns the interned configurations and their memoised transitions.
+//! \details The pool assumes a static topology: memoised transitions do not
+//! observe later changes to super links. The pool outlives every machine
+//! sharing its configurations.
+//! \note The pool is not thread-safe and should be accessed only from a single
+//! thread.
+template <typename Topology> class configuration_pool {
+public:
+  using transition = typename state_machine<Topology>::transition;
+
+  configuration_pool() { configurations.push_back({this, nullptr, nullptr}); }
+
+  configuration_pool(const configuration_pool &) = delete;
+  configuration_pool &operator=(const configuration_pool &) = delete;
+
+  //! \brief Get the empty configuration, where no states are active.
+  const configuration<Topology> *empty() const {
+    return &configurations.front();
+  }
+
+  //! \brief Get the number of distinct configurations interned so far.
+  std::size_t size() const { return configurations.size(); }
+
+  //! \brief Transition from one configuration to a new state.
+  //! \details Looks up the memoised transition first. A miss computes the
+  //! transition exactly as state_machine::go would, interning the resulting
+  //! configuration.
+  //! \param from The current configuration from this pool.
+  //! \param to The new state to transition to.
+  //! \return The new configuration and the states exited and entered.
+  const std::pair<const configuration<Topology> *, transition> &
+  go(const configuration<Topology> *from, state<Topology> *to) {
+    auto memo = from->gos.find(to);
+    if (memo != from->gos.end())
+      return memo->second;
+    transition go;
+    // Walk up from the target to the root, stopping on revisiting a state;
+    // duplicates correspond to cyclic state topologies.
+    std::unordered_set<state<Topology> *> visited;
+    for (auto super = to; super && visited.insert(super).second;
+         super = super->super)
+      go.enters.push_front(super);
+    // Match up the active states with the enters, outer to inner.
+    std::vector<const configuration<Topology> *> supers(from->size);
+    for (auto config = from; config->super; config = config->super)
+      supers[config->size - 1] = config;
+    std::size_t depth = 0;
+    while (depth < supers.size() && !go.enters.empty() &&
+           supers[depth]->top == go.enters.front()) {
+      depth++;
+      go.enters.pop_front();
+    }
+    auto config = from;
+    for (; config->size > depth; config = config->super)
+      go.exits.push_back(config->top);
+    for (auto enter : go.enters)
+      config = sub(config, enter);
+    return from->gos.emplace(to, std::make_pair(config, std::move(go)))
+        .first->second;
+  }
+
+private:
+  //! \brief Intern a configuration nesting a state within another.
+  const configuration<Topology> *sub(const configuration<Topology> *super,
+                                     state<Topology> *top) {
+    auto interned = super->subs.find(top);
+    if (interned != super->subs.end())
+      return interned->second;
+    configurations.push_back({this, super, top});
+    return super->subs.emplace(top, &configurations.back()).first->second;
+  }
+
+  //! \brief The interned configurations, the empty one first.
+  //! \details A deque keeps their addresses stable as the pool grows.
+  std::deque<configuration<Topology>> configurations;
+};
+
+//! \brief A state machine sharing interned configurations.
+//! \details The machine holds one pointer to its current configuration and
+//! nothing else. Transitions are memoised by the configuration pool, so
+//! repeated transitions cost a single look-up.
+template <typename Topology> class shared_state_machine {
+public:
+  using transition = typename state_machine<Topology>::transition;
+
+  //! \brief Construct a state machine in a pool's empty configuration.
+  //! \param pool The configuration pool; it must outlive the machine.
+  explicit shared_state_machine(configuration_pool<Topology> &pool)
+      : config(pool.empty()) {}
+
+  //! \brief Transition to a new state.
+  //! \param to The new state to transition to.
+  //! \return The memoised states exited and entered during the transition.
+  const transition &go(state<Topology> *to) {
+    const auto &go = config->pool->go(config, to);
+    config = go.first;
+    return go.second;
+  }
+
+  //! \brief Get the current, shared configuration.
+  const configuration<Topology> *configured() const { return config; }
+
+  //! \brief Get the current state.
+  //! \return The current state, or \c nullptr if there is no active state.
+  state<Topology> *at() const { return config->at(); }
+
+  //! \brief Check if a state is active.
+  //! \param state The state to check.
+  //! \return Answers \c true if the state is active, \c false otherwise.
+  bool in(state<Topology> *state) const { return config->in(state); }
+
+private:
+  const configuration<Topology> *config;
+};
+
+} /* namespace infinite */
+
+#endif /* INFINITE_CONFIGURATION_HPP_ */
@@ -16,11 +16,132 @@
 #ifndef INFINITE_STATE_H
 #define INFINITE_STATE_H
 
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * \brief Alignment of state-local storage.
+ * Defaults to two pointers unless already defined before the inclusion point
+ * of this header. Two pointers match the strictest fundamental alignment on
+ * typical 32- and 64-bit targets.
+ */
+#ifndef INFINITE_STATE_ALIGNMENT
+#define INFINITE_STATE_ALIGNMENT (2 * sizeof(void *))
+#endif
+
+/*!
+ * \brief Rounds a storage size up to the state-local storage alignment.
+ */
+#define INFINITE_STATE_ALIGN(size) \
+    (((size) + INFINITE_STATE_ALIGNMENT - 1) / INFINITE_STATE_ALIGNMENT * INFINITE_STATE_ALIGNMENT)
+
+/*!
+ * \brief Storage class of the public C functions.
+ * Empty by default, giving ordinary external functions compiled into the
+ * library. The single-header amalgamation defines it as \c{static inline} so
+ * that each including translation unit carries its own inlinable definitions;
+ * see \c{infinite_state_machine_amalgamation.h}.
+ */
+#ifndef INFINITE_STATE_API
+#define INFINITE_STATE_API
+#endif
+
 /*
- * forward declaration of the infinite state machine
+ * forward declarations of the infinite state and machine
  */
+struct infinite_state;
 struct infinite_state_machine;
 
+/*!
+ * \brief Width of compressed state references in bits.
+ * Defaults to 0 unless already defined before the inclusion point of this
+ * header, meaning that states refer to each other, and machines to states, by
+ * ordinary pointers. Define as 32, or 16 for small topologies, to reference
+ * states by offsets within a single topology arena instead. The library and all
+ * its users must agree on the width.
+ *
+ * Compressed references halve the machine's stack of active states on 64-bit
+ * builds, improving cache density when scanning arrays of machines. All states
+ * must then live within the arena starting at \c{infinite_state_base}, for
+ * example as members of one topology structure. Reference 0 denotes \c NULL.
+ */
+#ifndef INFINITE_STATE_REF_BITS
+#define INFINITE_STATE_REF_BITS 0
+#endif
+
+#if INFINITE_STATE_REF_BITS == 0
+
+/*!
+ * \brief A reference to a state: a pointer.
+ */
+typedef const struct infinite_state *infinite_state_ref;
+
+#define INFINITE_STATE_REF(state) (state)
+#define INFINITE_STATE_DEREF(ref) (ref)
+
+/*!
+ * \brief Initialises a reference to a member state of a topology object.
+ * \param type The topology type.
+ * \param object The topology object.
+ * \param member The member designating the state within the topology.
+ */
+#define INFINITE_STATE_REF_OF(type, object, member) (&(object).member)
+
+#else
+
+#include <assert.h>
+#include <stdint.h>
+
+#if INFINITE_STATE_REF_BITS == 32
+typedef uint32_t infinite_state_ref;
+#elif INFINITE_STATE_REF_BITS == 16
+typedef uint16_t infinite_state_ref;
+#else
+#error "INFINITE_STATE_REF_BITS must be 0, 16 or 32"
+#endif
+
+/*!
+ * \brief The base address of the topology arena.
+ * Assign before using any machine, typically the address of the topology
+ * object.
+ */
+extern const void *infinite_state_base;
+
+/*!
+ * \brief Compresses a pointer to a state within the topology arena.
+ * Asserts that the state lies within the arena and that its offset fits the
+ * reference width; a 16-bit reference would otherwise truncate silently on
+ * arenas of 64 KiB or more.
+ * \param state The state, or \c NULL.
+ * \return The state's reference, or 0 for \c NULL.
+ */
+static inline infinite_state_ref infinite_state_compress(const struct infinite_state *state)
+{
+    if (state == NULL)
+    {
+        return 0;
+    }
+    ptrdiff_t offset = (const unsigned char *)state - (const unsigned char *)infinite_state_base;
+    assert(offset >= 0 && (uintmax_t)offset < (infinite_state_ref)-1);
+    return (infinite_state_ref)(offset + 1);
+}
+
+#define INFINITE_STATE_REF(state) infinite_state_compress(state)
+#define INFINITE_STATE_DEREF(ref)                                                                  \
+    ((ref) == 0 ? NULL : (const struct infinite_state *)((const unsigned char *)infinite_state_base + (ref) - 1))
+/*
+ * The array of negative size rejects members beyond the reference width at
+ * compile time, leaving the reference a constant for static initialisers.
+ */
+#define INFINITE_STATE_REF_OF(type, object, member)                                                \
+    ((infinite_state_ref)(offsetof(type, member) + 1 +                                             \
+                          0 * sizeof(char[offsetof(type, member) < (infinite_state_ref)-1 ? 1 : -1])))
+
+#endif
+
 /*!
  * \brief The state structure for the infinite state.
  * This structure represents a state in the infinite state machine. It contains
@@ -31,8 +152,9 @@ struct infinite_state
 {
     /*!
      * \brief The parent state of this state.
+     * \note A pointer unless compressed; see \c{INFINITE_STATE_REF_BITS}.
      */
-    struct infinite_state *super;
+    infinite_state_ref super;
 
     /*!
      * \brief The enter action for this state.
@@ -44,7 +166,7 @@ struct infinite_state
      * \param state The incoming sub-state.
      * \param machine The infinite state machine.
      */
-    void (*enter)(struct infinite_state *state, struct infinite_state_machine *machine);
+    void (*enter)(const struct infinite_state *state, struct infinite_state_machine *machine);
 
     /*!
      * \brief The exit action for this state.
@@ -56,7 +178,34 @@ struct infinite_state
      * \param state The outgoing sub-state.
      * \param machine The infinite state machine.
      */
-    void (*exit)(struct infinite_state *state, struct infinite_state_machine *machine);
+    void (*exit)(const struct infinite_state *state, struct infinite_state_machine *machine);
+
+    /*!
+     * \brief The size of this state's local storage in bytes, or 0 for none.
+     * \note A machine with an arena allocates the storage when pushing the
+     * state and releases it when popping, in LIFO order. The storage is
+     * uninitialised; the enter action typically initialises it. Do not change
+     * the size while the state is active.
+     */
+    size_t size;
+
+    /*!
+     * \brief The default sub-state to enter, or \c NULL for none.
+     * \note Going to a state enters its initial sub-state, then that
+     * sub-state's own initial sub-state and so on, as part of the same entry
+     * path. The initial sub-state's super-state must be this state.
+     */
+    infinite_state_ref initial;
+
+    /*!
+     * \brief The state to go to once this state has entered, or \c NULL for
+     * none.
+     * \note The completion transition fires when this state is the innermost
+     * state entered by a transition, after all enter actions have run. Chains
+     * of completions resolve one after another without recursion; they must
+     * end.
+     */
+    infinite_state_ref completion;
 };
 
 /*!
@@ -70,7 +219,33 @@ struct infinite_state
  * \param topology The topology array to fill.
  * \return The updated topology array.
  */
-struct infinite_state **infinite_state_topology(struct infinite_state *state, int depth,
-                                                struct infinite_state **topology);
+INFINITE_STATE_API const struct infinite_state **infinite_state_topology(const struct infinite_state *state, int depth,
+                                                                         const struct infinite_state **topology);
+
+/*!
+ * \brief Get the depth of a state.
+ * \details Counts the state and all its super-states. The maximum across the
+ * innermost states of a topology sizes any machine walking that topology.
+ * \param state The innermost state.
+ * \param depth The maximum depth.
+ * \return The number of states from the root down to \p state inclusive, at
+ * most \p depth.
+ */
+INFINITE_STATE_API int infinite_state_depth(const struct infinite_state *state, int depth);
+
+/*!
+ * \brief Get the arena storage required by a state and its super-states.
+ * \details Sums the aligned local storage sizes of the state and all its
+ * super-states. The maximum across the innermost states of a topology bounds
+ * the arena of any machine walking that topology.
+ * \param state The innermost state.
+ * \param depth The maximum depth.
+ * \return The arena storage in bytes.
+ */
+INFINITE_STATE_API size_t infinite_state_size(const struct infinite_state *state, int depth);
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif /* INFINITE_STATE_H */
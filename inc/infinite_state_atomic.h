@@ -0,0 +1,25 @@
+/*
+ * SPDX-FileCopyrightText: 2023, Roy Ratcliffe, Northumberland, United Kingdom
+ * SPDX-License-Identifier: MIT
+ */
+/*!
+ * \file infinite_state_atomic.h
+ * \brief Atomic members shared between C and C++.
+ * \details Structures with atomic members declare them using
+ * \c{INFINITE_STATE_ATOMIC()}: \c _Atomic in C, \c std::atomic in C++. The two
+ * share size, alignment and representation on the supported compilers, as
+ * C++23 requires, so the same structure works from either language.
+ */
+
+#ifndef INFINITE_STATE_ATOMIC_H
+#define INFINITE_STATE_ATOMIC_H
+
+#ifdef __cplusplus
+#include <atomic>
+#define INFINITE_STATE_ATOMIC(type) std::atomic<type>
+#else
+#include <stdatomic.h>
+#define INFINITE_STATE_ATOMIC(type) _Atomic(type)
+#endif
+
+#endif /* INFINITE_STATE_ATOMIC_H */
@@ -0,0 +1,110 @@
+/*
+ * SPDX-FileCopyrightText: 2023, Roy Ratcliffe, Northumberland, United Kingdom
+ * SPDX-License-Identifier: MIT
+ */
+/*!
+ * \file infinite_state_counter.h
+ * \brief Transition-frequency counters.
+ * \details Counts each (from, to) state pair transitioned in C, whether by
+ * goto, by kind, by completion or by committing a transaction, or through go
+ * in C++, building a transition-frequency matrix. Both engines skip going
+ * to the current state, counting only transitions that change it. The counts
+ * show which transitions deserve fast paths, which states to co-locate in
+ * memory, and what workload to train profile-guided optimisation with.
+ *
+ * Each thread counts into its own shard, so recording never contends between
+ * threads. A thread claims a shard on its first transition, reusing one that an
+ * exited thread released or else allocating another; shards therefore number
+ * at most the threads ever live at once. Merging sums the shards, including
+ * counts left by threads since exited. Build with the CMake option
+ * \c INFINITE_COUNTERS, which defines \c INFINITE_STATE_COUNTER for the library
+ * and its users.
+ *
+ * Counters key states by address, as \c{const void *}, so that both the C and
+ * the C++ engines can record into them.
+ */
+
+#ifndef INFINITE_STATE_COUNTER_H
+#define INFINITE_STATE_COUNTER_H
+
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * \brief Number of distinct transitions each thread's shard can count.
+ * Defaults to 256 unless already defined when building the library.
+ */
+#ifndef INFINITE_STATE_COUNTER_PAIRS
+#define INFINITE_STATE_COUNTER_PAIRS 256
+#endif
+
+/*!
+ * \brief A transition and its frequency.
+ */
+struct infinite_state_counter
+{
+    /*!
+     * \brief The state transitioned from, or \c NULL if none.
+     */
+    const void *from;
+
+    /*!
+     * \brief The state transitioned to, or \c NULL if none.
+     */
+    const void *to;
+
+    /*!
+     * \brief The number of transitions.
+     */
+    unsigned long count;
+};
+
+/*!
+ * \brief Records a transition in the calling thread's shard.
+ * Transitions beyond the shard's capacity count as dropped.
+ * \param from The state transitioned from.
+ * \param to The state transitioned to.
+ */
+void infinite_state_counter_record(const void *from, const void *to);
+
+/*!
+ * \brief Merges the counts across all shards.
+ * \param counters The merged transitions, in no particular order.
+ * \param size The capacity of \p counters.
+ * \return The number of distinct transitions if at most \p size; otherwise a
+ * larger upper bound on their number, with only the first \p size merged into
+ * \p counters. Pass a \c NULL array of size 0 to find the bound.
+ * \note Merging takes time quadratic in the number of distinct transitions,
+ * which suits a transition matrix's modest size.
+ */
+int infinite_state_counter_merge(struct infinite_state_counter *counters, int size);
+
+/*!
+ * \brief Dumps the merged counts.
+ * Writes one line per transition: from, to and count, separated by spaces.
+ * \param file The file to write to.
+ * \param name Names a state, or \c NULL to write state addresses.
+ * \return The number of transitions written, or a negative error code on
+ * failure.
+ */
+int infinite_state_counter_dump(FILE *file, const char *(*name)(const void *state));
+
+/*!
+ * \brief Discards all counts in all shards.
+ * \note Not safe while other threads transition.
+ */
+void infinite_state_counter_reset(void);
+
+/*!
+ * \brief Gets the number of transitions dropped because a shard was full.
+ */
+unsigned long infinite_state_counter_dropped(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INFINITE_STATE_COUNTER_H */
@@ -0,0 +1,108 @@
+/*
+ * SPDX-FileCopyrightText: 2023, Roy Ratcliffe, Northumberland, United Kingdom
+ * SPDX-License-Identifier: MIT
+ */
+/*!
+ * \file infinite_state_coverage.h
+ * \brief Always-on state and transition coverage bitmap.
+ * \details Sets one bit for each state entered, one for each state exited and
+ * one for each (from, to) transition observed, whether in C by goto, by kind,
+ * by completion or by committing a transaction, or through go in C++. Going to the current state covers no transition in either engine.
+ * Production builds thereby gather coverage of the state graph without
+ * tracing, and fuzzing harnesses can steer towards new bits.
+ *
+ * Bits index by hashing state addresses, as in edge-coverage fuzzers; distinct
+ * states or transitions occasionally share a bit. Setting a bit first loads
+ * its byte and writes only if the bit is clear, so covered paths cost a
+ * relaxed load and never contend. Build with the CMake option
+ * \c INFINITE_COVERAGE, which defines \c INFINITE_STATE_COVERAGE for the
+ * library and its users.
+ */
+
+#ifndef INFINITE_STATE_COVERAGE_H
+#define INFINITE_STATE_COVERAGE_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * \brief Number of bits in each of the state and transition bitmaps.
+ * Defaults to 65536 unless already defined when building the library. Must be
+ * a power of two.
+ */
+#ifndef INFINITE_STATE_COVERAGE_BITS
+#define INFINITE_STATE_COVERAGE_BITS 65536
+#endif
+
+/*!
+ * \brief Covers a state's entry.
+ * \param state The state entered.
+ */
+void infinite_state_coverage_enter(const void *state);
+
+/*!
+ * \brief Covers a state's exit.
+ * \param state The state exited.
+ */
+void infinite_state_coverage_exit(const void *state);
+
+/*!
+ * \brief Covers a transition.
+ * \param from The state transitioned from, or \c NULL if none.
+ * \param to The state transitioned to, or \c NULL if none.
+ */
+void infinite_state_coverage_transition(const void *from, const void *to);
+
+/*!
+ * \brief Checks whether a state has entered.
+ * \return 1 if covered, else 0.
+ */
+int infinite_state_coverage_entered(const void *state);
+
+/*!
+ * \brief Checks whether a state has exited.
+ * \return 1 if covered, else 0.
+ */
+int infinite_state_coverage_exited(const void *state);
+
+/*!
+ * \brief Checks whether a transition has occurred.
+ * \return 1 if covered, else 0.
+ */
+int infinite_state_coverage_transitioned(const void *from, const void *to);
+
+/*!
+ * \brief Counts the bits set across both bitmaps.
+ * A fuzzing harness keeps inputs that raise the count.
+ */
+size_t infinite_state_coverage_bits(void);
+
+/*!
+ * \brief Dumps the coverage of a topology.
+ * Writes one line per state, its name followed by \c entered and \c exited
+ * where covered; then one line per covered transition between the states,
+ * from and to separated by a space.
+ * \param file The file to write to.
+ * \param states The topology's states.
+ * \param count The number of states.
+ * \param name Names a state, or \c NULL to write state addresses.
+ * \return The number of covered transitions written, or a negative error code
+ * on failure.
+ */
+int infinite_state_coverage_dump(FILE *file, const void *const states[], int count,
+                                 const char *(*name)(const void *state));
+
+/*!
+ * \brief Clears both bitmaps.
+ */
+void infinite_state_coverage_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INFINITE_STATE_COVERAGE_H */
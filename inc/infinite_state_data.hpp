@@ -0,0 +1,108 @@
+// SPDX-License-Identifier: MIT
+//! \file infinite_state_data.hpp
+//! \details This file contains a state machine with typed per-state data.
+//! Each active state owns a data object, constructed in place on entry and
+//! destroyed on exit. The machine keeps the data in a deque, one element per
+//! nesting level, allocated in blocks that it reuses as levels come and go.
+
+#ifndef INFINITE_STATE_DATA_HPP_
+#define INFINITE_STATE_DATA_HPP_
+
+#include "infinite_state_machine.hpp"
+
+// for per-level storage with stable addresses
+#include <deque>
+#include <variant>
+
+namespace infinite {
+
+//! \brief Construct a state's data in place.
+//! \details Use a specialisation as a state's \c emplace member; for example,
+//! \c{infinite::emplace<counter, data_type>} constructs a default \c counter.
+//! \tparam Data The data type to construct.
+//! \tparam Variant The machine's data variant.
+template <typename Data, typename Variant> void emplace(Variant &data) {
+  data.template emplace<Data>();
+}
+
+//! \brief A state machine whose active states own typed data.
+//! \details Each nesting level holds a variant of the possible data types, or
+//! \c std::monostate for none. The topology declares a member \c emplace, a
+//! pointer to a function constructing the state's data within the variant, or
+//! \c nullptr for states without data. Entering a state constructs its data;
+//! exiting destroys it, inner to outer. A data constructor that throws
+//! leaves its state unentered: the machine stops at the state's super-state
+//! with the data of every active state constructed, then rethrows.
+//! \note The base state machine is private; its go() would neither construct
+//! nor destroy any data. Only its queries are public.
+//! \tparam Topology The state topology.
+//! \tparam Data The possible data types.
+template <typename Topology, typename... Data>
+class data_state_machine : private state_machine<Topology> {
+public:
+  using data_type = std::variant<std::monostate, Data...>;
+  using transition = typename state_machine<Topology>::transition;
+  using size_type = typename state_machine<Topology>::size_type;
+
+  using state_machine<Topology>::at;
+  using state_machine<Topology>::in;
+  using state_machine<Topology>::depth;
+
+  //! \brief Transition to a new state.
+  //! \details Destroys the data of the exited states from sub to super, then
+  //! constructs the data of the entered states from super to sub.
+  //! \param to The new state to transition to.
+  //! \return A struct containing the states that were exited and entered during
+  //! the transition.
+  //! \throws Whatever a data constructor throws, after exiting the states
+  //! entered without data.
+  transition go(state<Topology> *to) {
+    transition go = state_machine<Topology>::go(to);
+    for (size_type exit = 0; exit < go.exits.size(); exit++)
+      datas.pop_back();
+    for (auto enter : go.enters) {
+      size_type level = datas.size();
+      try {
+        datas.emplace_back();
+        if (auto emplace = enter->self()->emplace)
+          emplace(datas.back());
+      } catch (...) {
+        // Keep the active states and their data in step.
+        if (datas.size() > level)
+          datas.pop_back();
+        this->unwind(level);
+        throw;
+      }
+    }
+    return go;
+  }
+
+  //! \brief Get the data of an active state.
+  //! \param state The state.
+  //! \return The state's data variant, or \c nullptr if the state is not
+  //! active.
+  data_type *data(state<Topology> *state) {
+    size_type level = this->level(state);
+    return level == datas.size() ? nullptr : &datas[level];
+  }
+
+  //! \brief Get the typed data of an active state.
+  //! \tparam T The data type.
+  //! \param state The state.
+  //! \return The state's data, or \c nullptr if the state is not active or
+  //! holds a different type of data.
+  template <typename T> T *get(state<Topology> *state) {
+    data_type *data = this->data(state);
+    return data ? std::get_if<T>(data) : nullptr;
+  }
+
+private:
+  //! \brief The data per nesting level, outer to inner.
+  //! \details The deque grows in blocks and never relocates its elements, so
+  //! data addresses remain stable while their states stay active.
+  std::deque<data_type> datas;
+};
+
+} /* namespace infinite */
+
+#endif /* INFINITE_STATE_DATA_HPP_ */
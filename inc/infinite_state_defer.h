@@ -0,0 +1,136 @@
+/*
+ * SPDX-FileCopyrightText: 2023, Roy Ratcliffe, Northumberland, United Kingdom
+ * SPDX-License-Identifier: MIT
+ */
+/*!
+ * \file infinite_state_defer.h
+ * \brief Deferred events, recalled when the deferring state exits.
+ * \details An active state can defer an event, as UML's \e defer does, rather
+ * than handle or discard it. The machine keeps the deferred event until the
+ * state exits, then splices it back to the head of its input queue ahead of
+ * events not yet dispatched. Deferring and recalling cost O(1) each; neither
+ * copies nor re-posts the event.
+ *
+ * Events are intrusive: embed a \c{struct infinite_state_event} in the
+ * application's own event and link that. Each deferral keeps one list per
+ * nesting level of the machine's stack. A state exits only after the states
+ * nested within it, so its level's list holds exactly the events that it
+ * deferred. Build with the CMake option \c INFINITE_DEFER, which defines
+ * \c INFINITE_STATE_DEFER for the library and its users.
+ */
+
+#ifndef INFINITE_STATE_DEFER_H
+#define INFINITE_STATE_DEFER_H
+
+#include "infinite_state_machine.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * \brief An intrusive event link.
+ */
+struct infinite_state_event
+{
+    /*!
+     * \brief The next event, or \c NULL if last.
+     */
+    struct infinite_state_event *next;
+};
+
+/*!
+ * \brief A first-in first-out queue of intrusive events.
+ */
+struct infinite_state_queue
+{
+    /*!
+     * \brief The first event, or \c NULL if empty.
+     */
+    struct infinite_state_event *head;
+
+    /*!
+     * \brief The last event's link, or the head's address if empty.
+     */
+    struct infinite_state_event **tail;
+};
+
+/*!
+ * \brief Per-level deferred events of a machine, plus the queue to recall
+ * them into.
+ */
+struct infinite_state_deferral
+{
+    /*!
+     * \brief The machine's input queue.
+     */
+    struct infinite_state_queue *queue;
+
+    /*!
+     * \brief The deferred events by nesting level, from 0 outermost.
+     */
+    struct infinite_state_queue levels[INFINITE_STATE_MACHINE_MAX_DEPTH];
+};
+
+/*!
+ * \brief Initialises an empty queue.
+ * \param queue The queue.
+ */
+void infinite_state_queue_init(struct infinite_state_queue *queue);
+
+/*!
+ * \brief Posts an event to the tail of a queue.
+ * \param queue The queue.
+ * \param event The event, not already queued.
+ */
+void infinite_state_queue_post(struct infinite_state_queue *queue, struct infinite_state_event *event);
+
+/*!
+ * \brief Takes the event at the head of a queue.
+ * \param queue The queue.
+ * \return The event, or \c NULL if the queue is empty.
+ */
+struct infinite_state_event *infinite_state_queue_take(struct infinite_state_queue *queue);
+
+/*!
+ * \brief Initialises a deferral with no deferred events.
+ * \param deferral The deferral.
+ * \param queue The input queue to recall deferred events into.
+ */
+void infinite_state_deferral_init(struct infinite_state_deferral *deferral, struct infinite_state_queue *queue);
+
+/*!
+ * \brief Attaches a deferral to a machine.
+ * Jumping keeps the deferral attached; initialising detaches it.
+ * \param machine The infinite state machine.
+ * \param deferral The deferral, or \c NULL to detach.
+ */
+void infinite_state_machine_deferral(struct infinite_state_machine *machine,
+                                     struct infinite_state_deferral *deferral);
+
+/*!
+ * \brief Defers an event until an active state exits.
+ * \param machine The infinite state machine with a deferral attached.
+ * \param state The deferring state; its innermost instance if active more
+ * than once.
+ * \param event The event, taken from the input queue.
+ * \return 0 on success, or a negative error code on failure; \c -EINVAL if the
+ * machine has no deferral or the state is not active.
+ */
+int infinite_state_machine_defer(struct infinite_state_machine *machine, const struct infinite_state *state,
+                                 struct infinite_state_event *event);
+
+/*!
+ * \brief Recalls the events deferred at a nesting level.
+ * Splices them, in their deferred order, to the head of the input queue. The
+ * machine calls this as each state exits; jumping recalls every level.
+ * \param deferral The deferral.
+ * \param level The nesting level; levels outside the deferral recall nothing.
+ */
+void infinite_state_deferral_recall(struct infinite_state_deferral *deferral, int level);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INFINITE_STATE_DEFER_H */
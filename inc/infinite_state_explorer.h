@@ -0,0 +1,164 @@
+/*
+ * SPDX-FileCopyrightText: 2023, Roy Ratcliffe, Northumberland, United Kingdom
+ * SPDX-License-Identifier: MIT
+ */
+/*!
+ * \file infinite_state_explorer.h
+ * \brief Parallel reachable-configuration explorer.
+ * \details Enumerates every active configuration reachable from an initial
+ * configuration through a transition table, breadth first, across all cores.
+ * The results size caches of configurations and reveal dead states, those
+ * never active in any reachable configuration.
+ *
+ * A model combines one or more orthogonal regions, each a machine over the
+ * same topology. A configuration packs each region's stack of active states,
+ * as in \c{states[]}, into a fixed-depth array of state identifiers: a state's
+ * index plus one, or 0 beyond the stack's depth. A transition from a source
+ * state active in its region goes to a target state, exactly as
+ * \c{infinite_state_machine_goto()} would, initial sub-states and completion
+ * transitions included. Build with the CMake option
+ * \c INFINITE_EXPLORER.
+ */
+
+#ifndef INFINITE_STATE_EXPLORER_H
+#define INFINITE_STATE_EXPLORER_H
+
+#include "infinite_state.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * \brief A state identifier: its index within the model's states plus one, or
+ * 0 for none.
+ */
+typedef uint32_t infinite_state_explorer_id;
+
+/*!
+ * \brief A transition within a region.
+ */
+struct infinite_state_explorer_transition
+{
+    /*!
+     * \brief The region, from 0.
+     */
+    int region;
+
+    /*!
+     * \brief The state that enables the transition when active.
+     */
+    const struct infinite_state *source;
+
+    /*!
+     * \brief The state to go to.
+     */
+    const struct infinite_state *target;
+};
+
+/*!
+ * \brief A model to explore.
+ */
+struct infinite_state_explorer
+{
+    /*!
+     * \brief The topology's states, identified by index plus one.
+     */
+    const struct infinite_state *const *states;
+
+    /*!
+     * \brief The number of states.
+     */
+    int count;
+
+    /*!
+     * \brief The maximum depth of each region's stack.
+     */
+    int depth;
+
+    /*!
+     * \brief The number of regions.
+     */
+    int regions;
+
+    /*!
+     * \brief Each region's initial state, or \c NULL for none.
+     */
+    const struct infinite_state *const *initial;
+
+    /*!
+     * \brief The transition table.
+     */
+    const struct infinite_state_explorer_transition *transitions;
+
+    /*!
+     * \brief The number of transitions.
+     */
+    int transitioned;
+
+    /*!
+     * \brief The number of threads, or 0 for one per online core.
+     */
+    int threads;
+
+    /*!
+     * \brief The maximum number of configurations to explore.
+     */
+    size_t capacity;
+};
+
+/*!
+ * \brief The results of exploring a model.
+ */
+struct infinite_state_exploration
+{
+    /*!
+     * \brief The number of reachable configurations.
+     */
+    size_t configurations;
+
+    /*!
+     * \brief The number of enabled transitions across all reachable
+     * configurations, self-transitions included.
+     */
+    size_t transitions;
+
+    /*!
+     * \brief The reachable configurations, in no particular order, each
+     * \c{regions * depth} identifiers wide.
+     */
+    infinite_state_explorer_id *ids;
+
+    /*!
+     * \brief Non-zero for each state, by index, active in some reachable
+     * configuration; zero for dead states.
+     */
+    unsigned char *reached;
+};
+
+/*!
+ * \brief Explores a model's reachable configurations.
+ * \param explorer The model.
+ * \param exploration The results, to free using
+ * \c{infinite_state_exploration_free()} after success.
+ * \return 0 on success, or a negative error code on failure; \c -ENOSPC if
+ * more configurations than the capacity are reachable, or \c -EINVAL if the
+ * model refers to states outside its topology.
+ */
+int infinite_state_explore(const struct infinite_state_explorer *explorer,
+                           struct infinite_state_exploration *exploration);
+
+/*!
+ * \brief Frees the results of an exploration.
+ * \param exploration The results.
+ */
+void infinite_state_exploration_free(struct infinite_state_exploration *exploration);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INFINITE_STATE_EXPLORER_H */
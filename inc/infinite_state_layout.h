@@ -0,0 +1,45 @@
+/*
+ * SPDX-FileCopyrightText: 2023, Roy Ratcliffe, Northumberland, United Kingdom
+ * SPDX-License-Identifier: MIT
+ */
+/*!
+ * \file infinite_state_layout.h
+ * \brief Frequency-driven topology memory layout.
+ * \details Copies topology nodes scattered across static data into one
+ * contiguous arena, ordered by a recorded transition-frequency profile so that
+ * hot ancestor chains share cache lines, and rewrites their links.
+ */
+
+#ifndef INFINITE_STATE_LAYOUT_H
+#define INFINITE_STATE_LAYOUT_H
+
+#include "infinite_state.h"
+#include "infinite_state_counter.h"
+
+/*!
+ * \brief Lays out topology nodes contiguously by transition frequency.
+ * \details Ranks each state by the number of transitions into or out of it,
+ * then places states hottest first, each preceded by any of its unplaced
+ * super-states from the root down. A hot state's ancestor chain therefore sits
+ * contiguously just before it. Cold states without transitions follow in
+ * their original order.
+ *
+ * Each node is a structure of \p size bytes whose first member is its
+ * infinite_state, as with all nodes of one homogeneous topology. The copies
+ * have their super, initial and completion links rewritten to the copied
+ * states; links to states not laid out remain unchanged.
+ * \param states The topology's states.
+ * \param count The number of states.
+ * \param size The size of each node in bytes.
+ * \param counters The transition-frequency profile, as merged by
+ * \c{infinite_state_counter_merge()}.
+ * \param counted The number of counters.
+ * \param arena Storage for \p count nodes of \p size bytes each.
+ * \param relocated Receives each state's copy, by index of \p states.
+ * \return 0 on success, or a negative error code on failure.
+ */
+int infinite_state_layout(const struct infinite_state *const states[], int count, size_t size,
+                          const struct infinite_state_counter counters[], int counted, void *arena,
+                          const struct infinite_state *relocated[]);
+
+#endif /* INFINITE_STATE_LAYOUT_H */
@@ -8,9 +8,9 @@
  * Provides functions to initialise, perform hierarchical transitions (goto and
  * jump), query whether a state is active, and get the current top state.
  *
- * The machine keeps a stack (array) of active states up to
- * \c{INFINITE_STATE_MACHINE_MAX_DEPTH}. Not thread-safe; external synchronisation
- * is required for concurrent use.
+ * The machine keeps a stack (array) of active states up to its own maximum
+ * depth, at most \c{INFINITE_STATE_MACHINE_MAX_DEPTH}. Not thread-safe; external
+ * synchronisation is required for concurrent use.
  */
 
 #ifndef INFINITE_STATE_MACHINE_H
@@ -18,45 +18,330 @@
 
 #include "infinite_state.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /*!
  * \brief Maximum depth of any infinite state machine.
  * Defaults to 7 unless already defined before the inclusion point of this header.
+ * Each machine has its own maximum depth up to this limit; see
+ * \c{INFINITE_STATE_MACHINE}. The limit also sizes the scratch topology used by
+ * transitions.
  *
- * Why 7? There is method in the choice a maximum depth of 7. Pointers and
- * integers are 32 bits wide on a 32-bit machine. Seven pointers and one integer
- * occupy 8 words, or 32 bytes. If a single machine requires more than seven
- * levels of nesting, better to refactor the design to reduce complexity.
+ * Why 7? Machines no longer pay for the limit; each stores only its own
+ * maximum depth. The scratch topologies that transitions keep on the stack
+ * bound the engine's stack usage instead. If a single machine requires more
+ * than seven levels of nesting, better to refactor the design to reduce
+ * complexity.
  */
 #ifndef INFINITE_STATE_MACHINE_MAX_DEPTH
 #define INFINITE_STATE_MACHINE_MAX_DEPTH 7
 #endif
 
+/*!
+ * \brief A stack arena for state-local storage.
+ * The caller supplies the storage. States bump-allocate their local storage
+ * from the arena on entry and release it on exit, in LIFO order matching the
+ * machine's push and pop discipline.
+ */
+struct infinite_state_arena
+{
+    /*!
+     * \brief The arena storage, aligned to \c{INFINITE_STATE_ALIGNMENT}.
+     */
+    unsigned char *base;
+
+    /*!
+     * \brief The size of the arena storage in bytes.
+     */
+    size_t size;
+
+    /*!
+     * \brief The number of bytes in use.
+     */
+    size_t used;
+};
+
 /*!
  * \brief Represents an infinite state machine.
  * This structure holds the current state hierarchy and allows for transitions
  * between states.
  * \note The structure is not thread-safe.
+ * \note The states form a flexible array member sized by the machine's maximum
+ * depth. Declare machines using \c{INFINITE_STATE_MACHINE} so that each pays
+ * only for the depth of its own topology.
  */
 struct infinite_state_machine
 {
+    /*!
+     * \brief The current depth of the infinite state machine.
+     */
+    int depth;
+
+    /*!
+     * \brief The maximum depth of the infinite state machine.
+     * \note Fixed by the declaration; initialisation does not change it.
+     */
+    int max_depth;
+
+    /*!
+     * \brief The optional arena for state-local storage, or \c NULL.
+     */
+    struct infinite_state_arena *arena;
+
+#ifdef INFINITE_STATE_ACTIVATIONS
+    /*!
+     * \brief The optional counts of entries by level, or \c NULL.
+     */
+    unsigned long *activations;
+#endif
+
+#ifdef INFINITE_STATE_DEFER
+    /*!
+     * \brief The optional deferral of events until states exit, or \c NULL.
+     */
+    struct infinite_state_deferral *deferral;
+#endif
+
+#ifdef INFINITE_STATE_REALTIME
+    /*!
+     * \brief The transaction committing, or \c NULL.
+     * \note Real-time machines turn goto requests made by actions into
+     * further requests of this transaction; actions never reenter.
+     */
+    struct infinite_state_machine_transaction *transaction;
+#endif
+
     /*!
      * \brief The states in the infinite state machine.
+     * \note Pointers unless compressed; see \c{INFINITE_STATE_REF_BITS}.
      */
-    struct infinite_state *states[INFINITE_STATE_MACHINE_MAX_DEPTH];
+    infinite_state_ref states[];
+};
 
+/*!
+ * \brief Size of an infinite state machine in bytes, given its maximum depth.
+ */
+#define INFINITE_STATE_MACHINE_SIZE(depth) \
+    (offsetof(struct infinite_state_machine, states) + (depth) * sizeof(infinite_state_ref))
+
+/*
+ * Static assertions for declarations, in either language.
+ */
+#ifdef __cplusplus
+#define INFINITE_STATE_STATIC_ASSERT(condition, message) static_assert(condition, message)
+#else
+#define INFINITE_STATE_STATIC_ASSERT(condition, message) _Static_assert(condition, message)
+#endif
+
+/*
+ * Initialisers for the optional members of a machine, so that declarations
+ * initialise every member explicitly.
+ */
+#ifdef INFINITE_STATE_ACTIVATIONS
+#define INFINITE_STATE_MACHINE_ACTIVATIONS_INIT , .activations = NULL
+#else
+#define INFINITE_STATE_MACHINE_ACTIVATIONS_INIT
+#endif
+#ifdef INFINITE_STATE_DEFER
+#define INFINITE_STATE_MACHINE_DEFERRAL_INIT , .deferral = NULL
+#else
+#define INFINITE_STATE_MACHINE_DEFERRAL_INIT
+#endif
+#ifdef INFINITE_STATE_REALTIME
+#define INFINITE_STATE_MACHINE_TRANSACTION_INIT , .transaction = NULL
+#else
+#define INFINITE_STATE_MACHINE_TRANSACTION_INIT
+#endif
+
+/*!
+ * \brief The type of an infinite state machine sized to a maximum depth.
+ * A union whose \c machine member is the infinite state machine, with storage
+ * for exactly \p maximum states. Use it for machines that are structure
+ * members or array elements, initialising each one with
+ * \c{INFINITE_STATE_MACHINE_INIT} or \c{infinite_state_machine_init_depth()}.
+ * For example:
+ * \code
+ * struct session
+ * {
+ *     INFINITE_STATE_MACHINE_TYPE(1) ism;
+ * };
+ * infinite_state_machine_init_depth(&session->ism.machine, 1);
+ * \endcode
+ * A depth beyond \c{INFINITE_STATE_MACHINE_MAX_DEPTH} fails to compile.
+ * \param maximum The maximum depth, at most
+ * \c{INFINITE_STATE_MACHINE_MAX_DEPTH}.
+ */
+#define INFINITE_STATE_MACHINE_TYPE(maximum)                                                         \
+    union                                                                                            \
+    {                                                                                                \
+        struct infinite_state_machine machine;                                                       \
+        unsigned char storage[INFINITE_STATE_MACHINE_SIZE(maximum)];                                 \
+        INFINITE_STATE_STATIC_ASSERT((maximum) > 0 && (maximum) <= INFINITE_STATE_MACHINE_MAX_DEPTH, \
+                                     "machine depth out of range");                                  \
+    }
+
+/*!
+ * \brief Initialises a machine of \c{INFINITE_STATE_MACHINE_TYPE(maximum)}.
+ * \param maximum The maximum depth, matching the type's.
+ */
+#define INFINITE_STATE_MACHINE_INIT(maximum)                                                         \
+    {.machine = {.depth = 0,                                                                         \
+                 .max_depth = (maximum),                                                             \
+                 .arena = NULL INFINITE_STATE_MACHINE_ACTIVATIONS_INIT                               \
+                     INFINITE_STATE_MACHINE_DEFERRAL_INIT INFINITE_STATE_MACHINE_TRANSACTION_INIT}}
+
+/*!
+ * \brief Declares an infinite state machine sized to a maximum depth.
+ * Declares a union named \p name whose \c machine member is the infinite state
+ * machine, with storage for exactly \p maximum states. Size the machine by
+ * its topology's deepest state; see \c{infinite_state_depth()}, or in C++
+ * \c{infinite_state_constexpr_depth()} at compile time. For example:
+ * \code
+ * static INFINITE_STATE_MACHINE(engine, 2);
+ * infinite_state_machine_goto(&engine.machine, &stopped);
+ * \endcode
+ * A depth beyond \c{INFINITE_STATE_MACHINE_MAX_DEPTH} fails to compile. Going
+ * to a state deeper than the machine fails rather than truncating.
+ * \note Always declare machines this way. A plain
+ * \c{struct infinite_state_machine} has no storage for its states and no
+ * maximum depth.
+ * \param name The name of the declared union.
+ * \param maximum The maximum depth, at most
+ * \c{INFINITE_STATE_MACHINE_MAX_DEPTH}.
+ */
+#define INFINITE_STATE_MACHINE(name, maximum) \
+    INFINITE_STATE_MACHINE_TYPE(maximum) name = INFINITE_STATE_MACHINE_INIT(maximum)
+
+/*!
+ * \brief Batches the transitions of an infinite state machine.
+ * A transaction records any number of goto requests without running any enter
+ * or exit actions. Committing the transaction then exits and enters only the
+ * net difference between the starting and final configurations; transient
+ * states in between never enter or exit.
+ * \note Actions run by the commit may request further transitions through the
+ * same transaction. Doing so interrupts the remaining exits or enters, which
+ * the commit recomputes against the new request. Actions only reach the
+ * transaction through context of their own, however; an action calling goto
+ * still recurses into a nested commit. Only real-time machines, built with
+ * \c{INFINITE_STATE_REALTIME}, track the committing transaction and turn goto
+ * from actions into its requests.
+ */
+struct infinite_state_machine_transaction
+{
     /*!
-     * \brief The current depth of the infinite state machine.
+     * \brief The machine under transaction.
      */
-    int depth;
+    struct infinite_state_machine *machine;
+
+    /*!
+     * \brief The latest requested state, possibly \c NULL.
+     */
+    const struct infinite_state *state;
+
+    /*!
+     * \brief Non-zero if a goto request is pending.
+     */
+    int pending;
+};
+
+/*!
+ * \brief Kinds of transition from an active source state.
+ * The kind decides whether the source exits and re-enters when the target
+ * lies within it. A target outside the source exits the source whatever the
+ * kind, just as going to the target would.
+ */
+enum infinite_state_transition_kind
+{
+    /*!
+     * \brief Exits and re-enters the source, even when the target is the
+     * source itself or lies within it.
+     */
+    INFINITE_STATE_TRANSITION_EXTERNAL,
+
+    /*!
+     * \brief Exits the source's active sub-states but not the source itself
+     * when the target is the source or lies within it.
+     */
+    INFINITE_STATE_TRANSITION_LOCAL,
+
+    /*!
+     * \brief Exits and enters nothing; the source handles an event in place.
+     */
+    INFINITE_STATE_TRANSITION_INTERNAL,
 };
 
 /*!
  * \brief Initialises the infinite state machine.
  * The machine is reset to its initial state. It has an initial depth of 0.
- * All its states are cleared to \c NULL for safety.
+ * All its states are cleared to \c NULL for safety. Its maximum depth remains
+ * unchanged.
  * \param machine The infinite state machine to initialise.
  */
-void infinite_state_machine_init(struct infinite_state_machine *machine);
+INFINITE_STATE_API void infinite_state_machine_init(struct infinite_state_machine *machine);
+
+/*!
+ * \brief Initialises an infinite state machine with a maximum depth.
+ * Initialises the machine as \c{infinite_state_machine_init()} does, after
+ * first setting its maximum depth; for machines declared by type rather than
+ * by \c{INFINITE_STATE_MACHINE}, or allocated dynamically.
+ * \param machine The infinite state machine, with storage for at least
+ * \p max_depth states; see \c{INFINITE_STATE_MACHINE_SIZE}.
+ * \param max_depth The maximum depth.
+ * \return 0 on success, or \c -EINVAL if the maximum depth is not between 1
+ * and \c{INFINITE_STATE_MACHINE_MAX_DEPTH}, in which case the machine does not
+ * change.
+ */
+INFINITE_STATE_API int infinite_state_machine_init_depth(struct infinite_state_machine *machine, int max_depth);
+
+/*!
+ * \brief Attaches a state-local storage arena to an empty machine.
+ * \param machine The infinite state machine, initialised and empty.
+ * \param arena The arena, or \c NULL to detach.
+ */
+INFINITE_STATE_API void infinite_state_machine_arena(struct infinite_state_machine *machine, struct infinite_state_arena *arena);
+
+#ifdef INFINITE_STATE_ACTIVATIONS
+/*!
+ * \brief Attaches activation counts to a machine.
+ * The machine then counts the entries at each level, by pushing or jumping.
+ * Leaving and re-entering a state changes its level's count, so that the count
+ * identifies the state's current activation; see
+ * \c{infinite_state_machine_activation()}.
+ * \note Only builds with \c{INFINITE_STATE_ACTIVATIONS} count activations;
+ * other machines carry no counts at all.
+ * \param machine The infinite state machine, initialised; initialising detaches
+ * the counts.
+ * \param activations The counts by level, at least the machine's maximum
+ * depth, typically zeroed; or \c NULL to detach.
+ */
+INFINITE_STATE_API void infinite_state_machine_activations(struct infinite_state_machine *machine, unsigned long *activations);
+
+/*!
+ * \brief Gets the activation count of an active state.
+ * \param machine The infinite state machine.
+ * \param state The state.
+ * \return The count of the state's level, or 0 if the state is not active or
+ * the machine counts no activations.
+ * \note O(n) time complexity applies, where n is the depth of the state machine.
+ */
+INFINITE_STATE_API unsigned long infinite_state_machine_activation(const struct infinite_state_machine *machine,
+                                                                  const struct infinite_state *state);
+#endif
+
+/*!
+ * \brief Gets the local storage of an active state.
+ * \param machine The infinite state machine.
+ * \param state The active state.
+ * \return The state's local storage, or \c NULL if the state is not active,
+ * has no local storage, or the machine has no arena.
+ * \note The storage is valid while the state is active, and while its exit
+ * actions run; the machine releases it only after they return. Exit actions of
+ * machines with arenas must not transition reentrantly.
+ * \note O(n) time complexity applies, where n is the depth of the state machine.
+ */
+INFINITE_STATE_API void *infinite_state_machine_data(const struct infinite_state_machine *machine, const struct infinite_state *state);
 
 /*!
  * \brief Goes to a state in the infinite state machine.
@@ -70,9 +355,46 @@ void infinite_state_machine_init(struct infinite_state_machine *machine);
  * Otherwise, all the exit actions for the current state are run, and the new
  * state is entered by running all enter actions.
  *
+ * Real-time machines, built with \c{INFINITE_STATE_REALTIME}, never recurse.
+ * Going to a state from an enter or exit action only requests the transition;
+ * it follows once the transition in progress stops.
+ *
+ * \warning Other builds keep the recursive behaviour. Going to a state from an
+ * enter or exit action there commits a nested transaction before the action
+ * returns; the outer transition then carries on entering or exiting from the
+ * configuration that the nested one left. Build with
+ * \c{INFINITE_STATE_REALTIME} for actions that transition.
+ *
+ * \return 0 on success, or a negative error code on failure; \c -ENOMEM if
+ * the state, with its super-states and initial sub-states, is deeper than the
+ * machine, in which case the machine does not change, or if the arena runs out
+ * of storage.
+ *
  * \note O(n) time complexity applies, where n is the depth of the state machine.
  */
-void infinite_state_machine_goto(struct infinite_state_machine *machine, struct infinite_state *state);
+INFINITE_STATE_API int infinite_state_machine_goto(struct infinite_state_machine *machine, const struct infinite_state *state);
+
+/*!
+ * \brief Transitions from an active source state by kind.
+ * \param machine The infinite state machine.
+ * \param source The active state owning the transition.
+ * \param target The state to go to; ignored by internal transitions.
+ * \param kind The kind of transition.
+ * \return 0 on success, or a negative error code on failure; \c -EINVAL if the
+ * source is not active, or \c -EBUSY if an action of a real-time machine
+ * attempts a transition by kind.
+ *
+ * Runs only the exit and enter actions that the kind requires. Internal
+ * transitions run none and never walk the topology. Local and external
+ * transitions walk up from the target no further than the source; only a
+ * target outside the source falls back to going to the target.
+ *
+ * \note O(n) time complexity applies, where n is the depth of the state machine.
+ */
+INFINITE_STATE_API int infinite_state_machine_transition(struct infinite_state_machine *machine,
+                                                         const struct infinite_state *source,
+                                                         const struct infinite_state *target,
+                                                         enum infinite_state_transition_kind kind);
 
 /*!
  * \brief Jumps to a state in the infinite state machine.
@@ -82,11 +404,18 @@ void infinite_state_machine_goto(struct infinite_state_machine *machine, struct
  * Jumping to a state in the infinite state machine resets the machine to its
  * initial state and then transitions to the specified state. This is useful
  * for resetting the machine to a known state without going through the
- * normal entry and exit actions.
+ * normal entry and exit actions. A machine with an arena reallocates
+ * state-local storage without initialising it; the machine must therefore be
+ * initialised, or zeroed, beforehand.
+ *
+ * \return 0 on success, or a negative error code on failure; \c -ENOMEM if
+ * the state is deeper than the machine, in which case the machine does not
+ * change, or if the arena runs out of storage, in which case the stack stops
+ * where the storage does.
  *
  * \note O(n) time complexity applies, where n is the depth of the state machine.
  */
-void infinite_state_machine_jump(struct infinite_state_machine *machine, struct infinite_state *state);
+INFINITE_STATE_API int infinite_state_machine_jump(struct infinite_state_machine *machine, const struct infinite_state *state);
 
 /*!
  * \brief Checks if a state is currently active in the infinite state machine.
@@ -94,13 +423,68 @@ void infinite_state_machine_jump(struct infinite_state_machine *machine, struct
  * \param state The state to check.
  * \return 1 if the state is active, 0 if it is not, or a negative error code on failure.
  */
-int infinite_state_machine_in(struct infinite_state_machine *machine, struct infinite_state *state);
+INFINITE_STATE_API int infinite_state_machine_in(const struct infinite_state_machine *machine, const struct infinite_state *state);
 
 /*!
  * \brief Gets the top state of the infinite state machine.
  * \param machine The infinite state machine.
  * \return The top state, or \c NULL if the machine is empty.
  */
-struct infinite_state *infinite_state_machine_top(const struct infinite_state_machine *machine);
+INFINITE_STATE_API const struct infinite_state *infinite_state_machine_top(const struct infinite_state_machine *machine);
+
+/*!
+ * \brief Begins a transaction on an infinite state machine.
+ * \param transaction The transaction to begin.
+ * \param machine The infinite state machine.
+ */
+INFINITE_STATE_API void infinite_state_machine_transaction_begin(struct infinite_state_machine_transaction *transaction,
+                                                                 struct infinite_state_machine *machine);
+
+/*!
+ * \brief Requests a transition within a transaction.
+ * The request replaces any earlier request. No actions run until commit.
+ * \param transaction The transaction.
+ * \param state The state to go to, or \c NULL.
+ */
+INFINITE_STATE_API void infinite_state_machine_transaction_goto(struct infinite_state_machine_transaction *transaction,
+                                                                const struct infinite_state *state);
+
+/*!
+ * \brief Commits a transaction.
+ * Goes to the latest requested state, exiting and entering only the net
+ * difference. Repeats while actions request further transitions through the
+ * transaction.
+ * \param transaction The transaction to commit.
+ * \return 0 on success, or the first negative error code of any request; see
+ * \c{infinite_state_machine_goto()}. A request failing because the machine is
+ * too shallow leaves the machine as it was.
+ */
+INFINITE_STATE_API int infinite_state_machine_transaction_commit(struct infinite_state_machine_transaction *transaction);
+
+#ifdef __cplusplus
+}
+
+#if !INFINITE_STATE_REF_BITS
+/*!
+ * \brief Gets the depth of a state at compile time.
+ * Counts the state and all its super-states, so that machines can be sized to
+ * constant-expression topologies; for example:
+ * \code
+ * static INFINITE_STATE_MACHINE(machine, infinite_state_constexpr_depth(&deepest));
+ * \endcode
+ * \param state The innermost state, or \c nullptr.
+ * \return The number of states from the root down to \p state inclusive.
+ */
+constexpr int infinite_state_constexpr_depth(const struct infinite_state *state)
+{
+    int depth = 0;
+    for (; state != nullptr; state = state->super)
+    {
+        depth++;
+    }
+    return depth;
+}
+#endif
+#endif
 
 #endif /* INFINITE_STATE_MACHINE_H */
@@ -6,11 +6,36 @@
 #ifndef INFINITE_STATE_MACHINE_HPP_
 #define INFINITE_STATE_MACHINE_HPP_
 
+// for static tracepoints
+#include "infinite_state_probe.h"
+
+// for optional transition-frequency counters
+#ifdef INFINITE_STATE_COUNTER
+#include "infinite_state_counter.h"
+#endif
+
+// for optional coverage bitmaps
+#ifdef INFINITE_STATE_COVERAGE
+#include "infinite_state_coverage.h"
+#endif
+
 // for efficient double-ended queue operations
 #include <deque>
 
-// for find algorithms
+// for min and max algorithms, and binary searches of the active levels
 #include <algorithm>
+#include <functional>
+
+// for sealed topology indices
+#include <unordered_map>
+#include <unordered_set>
+
+// for sealed topology indices
+#include <cstddef>
+#include <initializer_list>
+#include <stdexcept>
+#include <utility>
+#include <vector>
 
 // Why infinite state machine? This state machine allows for an arbitrary number
 // of nested states, enabling complex state hierarchies and transitions. No
@@ -27,12 +52,189 @@ template <typename Topology> struct state {
   topology_ptr self() { return static_cast<topology_ptr>(this); }
 };
 
+//! \brief A sealed least-common-ancestor index over a state topology.
+//! \details Seals a snapshot of the topology's super links: the states given
+//! plus all their super-states. Binary lifting answers the least common
+//! ancestor of two states in O(log d) time, where d is the depth; an Euler
+//! tour answers ancestry in constant time. Guard code can use the index rather
+//! than walking super pointers itself.
+//!
+//! The index does not observe later changes to the topology. Re-seal a new
+//! index after changing any super link.
+template <typename Topology> class state_index {
+public:
+  using size_type = std::size_t;
+
+  //! \brief Seal an index over a range of states and their super-states.
+  //! \param first The first state pointer.
+  //! \param last One past the last state pointer.
+  //! \throws std::invalid_argument if the topology contains a cycle.
+  template <typename Iterator> state_index(Iterator first, Iterator last) {
+    for (; first != last; ++first)
+      seal(*first);
+    tour();
+    lift();
+  }
+
+  //! \brief Seal an index over a list of states and their super-states.
+  state_index(std::initializer_list<state<Topology> *> states)
+      : state_index(states.begin(), states.end()) {}
+
+  //! \brief Check if the index covers a state.
+  //! \param state The state to check.
+  //! \return Answers \c true if the state or one of its sub-states was sealed.
+  bool contains(state<Topology> *state) const {
+    return ids.find(state) != ids.cend();
+  }
+
+  //! \brief Get the depth of a state.
+  //! \param state A state covered by the index.
+  //! \return The number of super-states above the state, 0 for a root.
+  size_type depth(state<Topology> *state) const {
+    return depths[ids.at(state)];
+  }
+
+  //! \brief Check if one state is an ancestor of, or the same as, another.
+  //! \param super The candidate ancestor covered by the index.
+  //! \param sub The candidate descendant covered by the index.
+  //! \return Answers \c true if \p super contains \p sub.
+  bool is_ancestor(state<Topology> *super, state<Topology> *sub) const {
+    return is_ancestor(ids.at(super), ids.at(sub));
+  }
+
+  //! \brief Find the least common ancestor of two states.
+  //! \param a A state covered by the index.
+  //! \param b Another state covered by the index.
+  //! \return The innermost state containing both, or \c nullptr if the two
+  //! states belong to different roots.
+  state<Topology> *lca(state<Topology> *a, state<Topology> *b) const {
+    size_type id = ids.at(a), other = ids.at(b);
+    if (is_ancestor(id, other))
+      return nodes[id];
+    if (is_ancestor(other, id))
+      return nodes[other];
+    // Lift as far as possible without containing the other state. The lifted
+    // state's parent is then the least common ancestor.
+    for (size_type k = ups.size(); k-- > 0;)
+      if (!is_ancestor(ups[k][id], other))
+        id = ups[k][id];
+    size_type parent = ups.empty() ? id : ups[0][id];
+    return is_ancestor(parent, other) ? nodes[parent] : nullptr;
+  }
+
+private:
+  static constexpr size_type npos = static_cast<size_type>(-1);
+
+  //! \brief Assign identifiers to a state and its unsealed super-states.
+  //! \details Identifiers ascend from super to sub, so a parent always has a
+  //! smaller identifier than its children.
+  void seal(state<Topology> *sub) {
+    std::vector<state<Topology> *> path;
+    std::unordered_set<state<Topology> *> visited;
+    state<Topology> *super = sub;
+    for (; super && !contains(super); super = super->super) {
+      if (!visited.insert(super).second)
+        throw std::invalid_argument("cyclic state topology");
+      path.push_back(super);
+    }
+    size_type parent = super ? ids.at(super) : npos;
+    for (auto it = path.rbegin(); it != path.rend(); ++it) {
+      ids.emplace(*it, nodes.size());
+      nodes.push_back(*it);
+      parents.push_back(parent);
+      depths.push_back(parent == npos ? 0 : depths[parent] + 1);
+      parent = nodes.size() - 1;
+    }
+  }
+
+  //! \brief Number the states by an Euler tour of the sealed forest.
+  //! \details A state's sub-states all have entry numbers within its entry and
+  //! exit numbers.
+  void tour() {
+    size_type size = nodes.size();
+    // Children in compressed sparse rows: firsts[id] to firsts[id + 1].
+    std::vector<size_type> firsts(size + 1, 0), children(size);
+    for (size_type id = 0; id < size; id++)
+      if (parents[id] != npos)
+        firsts[parents[id] + 1]++;
+    for (size_type id = 0; id < size; id++)
+      firsts[id + 1] += firsts[id];
+    std::vector<size_type> fill(firsts.begin(), firsts.end() - 1);
+    for (size_type id = 0; id < size; id++)
+      if (parents[id] != npos)
+        children[fill[parents[id]]++] = id;
+    entries.assign(size, 0);
+    exits.assign(size, 0);
+    size_type clock = 0;
+    std::vector<std::pair<size_type, size_type>> stack;
+    for (size_type root = 0; root < size; root++) {
+      if (parents[root] != npos)
+        continue;
+      entries[root] = clock++;
+      stack.emplace_back(root, firsts[root]);
+      while (!stack.empty()) {
+        auto &[id, next] = stack.back();
+        if (next == firsts[id + 1]) {
+          exits[id] = clock++;
+          stack.pop_back();
+          continue;
+        }
+        size_type child = children[next++];
+        entries[child] = clock++;
+        stack.emplace_back(child, firsts[child]);
+      }
+    }
+  }
+
+  //! \brief Build the binary lifting table.
+  //! \details Row k holds each state's 2^k-th ancestor, or the root itself.
+  void lift() {
+    size_type size = nodes.size(), depth = 0;
+    for (size_type id = 0; id < size; id++)
+      depth = std::max(depth, depths[id]);
+    if (depth == 0)
+      return;
+    std::vector<size_type> up(size);
+    for (size_type id = 0; id < size; id++)
+      up[id] = parents[id] == npos ? id : parents[id];
+    ups.push_back(std::move(up));
+    for (size_type span = 2; span <= depth; span *= 2) {
+      const std::vector<size_type> &half = ups.back();
+      std::vector<size_type> up(size);
+      for (size_type id = 0; id < size; id++)
+        up[id] = half[half[id]];
+      ups.push_back(std::move(up));
+    }
+  }
+
+  bool is_ancestor(size_type super, size_type sub) const {
+    return entries[super] <= entries[sub] && exits[sub] <= exits[super];
+  }
+
+  std::unordered_map<state<Topology> *, size_type> ids;
+  std::vector<state<Topology> *> nodes;
+  std::vector<size_type> parents, depths, entries, exits;
+  std::vector<std::vector<size_type>> ups;
+};
+
 //! \brief A state machine topology navigation class.
 //! \details This class provides methods to navigate through the state machine's
 //! topology, allowing for transitions between states and querying the current
 //! state.
 template <typename Topology> class state_machine {
 public:
+  using size_type = typename std::deque<state<Topology> *>::size_type;
+
+  //! \brief Construct a state machine that walks the topology's super links.
+  state_machine() = default;
+
+  //! \brief Construct a state machine over a sealed topology index.
+  //! \details Transitions between indexed states find their least common
+  //! ancestor using the index, then walk only from the new state up to it.
+  //! Transitions involving unindexed states walk the super links as usual.
+  //! \param index The sealed index; it must outlive the state machine.
+  explicit state_machine(const state_index<Topology> *index) : index(index) {}
+
   //! \brief Destructor for the state machine.
   //! \details Cleans up the state machine and releases any resources.
   virtual ~state_machine() {}
@@ -42,6 +244,9 @@ public:
   // state_machine& operator= (state_machine &&other);
   // state_machine& operator= (const state_machine &other);
 
+  //! \brief Kinds of transition from an active source state.
+  enum class transition_kind { external, local, internal };
+
   //! \brief A struct representing the states exited and entered during a
   //! transition.
   //! \details This struct holds the states that were exited and entered during
@@ -64,37 +269,82 @@ public:
   //! conclusion since the duplicated state re-enters from a different
   //! super-state. The nesting differs.
   //!
+  //! \note O(n) time complexity applies, where n is the distance from the
+  //! current and new states to their least common ancestor, not the depth of
+  //! the state machine.
+  //!
   //! \param to The new state to transition to.
   //! \return A struct containing the states that were exited and entered during
   //! the transition.
   struct transition go(state<Topology> *to) {
-    std::deque<state<Topology> *> exits, enters;
-    // super, sub --> sub, super (reverse)
-    exits.assign(states.rbegin(), states.rend());
-    states.clear();
-    if (to != nullptr) {
-      // super.super, super, to!
-      //
-      // Avoid duplicating states in the enters deque.
-      // Duplicates correspond to cyclic state topologies.
-      for (;
-           to && std::find(enters.rbegin(), enters.rend(), to) == enters.rend();
-           to = to->super)
-        enters.push_front(to);
-      // Now match up the exits and enters.
-      // Transfer any matching states from exits to states.
-      while (!exits.empty() && !enters.empty() &&
-             exits.back() == enters.front()) {
-        states.push_back(exits.back());
-        exits.pop_back();
-        enters.pop_front();
-      }
-      states.insert(states.end(), enters.begin(), enters.end());
+    INFINITE_STATE_PROBE3(go__start, this, at(), to);
+#ifdef INFINITE_STATE_COUNTER
+    if (to != at())
+      infinite_state_counter_record(at(), to);
+#endif
+#ifdef INFINITE_STATE_COVERAGE
+    if (to != at())
+      infinite_state_coverage_transition(at(), to);
+#endif
+    std::deque<state<Topology> *> enters;
+    size_type depth = index && to && !states.empty() && index->contains(to) &&
+                              index->contains(states.back())
+                          ? lift(to, enters)
+                          : walk(to, enters);
+    // Keep the active states down to the least common ancestor.
+    auto exits = shift(depth, enters);
+    INFINITE_STATE_PROBE2(go__done, this, to);
+    return {exits, enters};
+  }
+
+  //! \brief Transition from an active source state by kind.
+  //! \details Internal transitions exit and enter nothing, and never walk the
+  //! topology. Local transitions keep the source when the new state is the
+  //! source or lies within it; external transitions exit and re-enter it. The
+  //! walk then goes up from the new state no further than the source. A new
+  //! state outside the source goes to it as usual, whatever the kind.
+  //! \param from The active source state.
+  //! \param to The new state; ignored by internal transitions.
+  //! \param kind The kind of transition.
+  //! \return The states exited and entered.
+  //! \throws std::invalid_argument if the source is not active.
+  struct transition go(state<Topology> *from, state<Topology> *to,
+                       transition_kind kind) {
+    size_type depth = level(from);
+    if (depth == states.size())
+      throw std::invalid_argument("inactive source state");
+    if (kind == transition_kind::internal)
+      return {};
+    // The sealed index answers ancestry outright and rules out cycles.
+    bool sealed = index && to && index->contains(from) && index->contains(to);
+    if (sealed && !index->is_ancestor(from, to))
+      return go(to);
+    std::deque<state<Topology> *> enters;
+    size_type span = sealed ? 0 : chain(to);
+    for (auto sub = to; sub != from; sub = sub->super) {
+      if (!sealed && span-- == 0)
+        return go(to);
+      enters.push_front(sub);
     }
+    INFINITE_STATE_PROBE3(go__start, this, at(), to);
+#ifdef INFINITE_STATE_COUNTER
+    if (to != at())
+      infinite_state_counter_record(at(), to);
+#endif
+#ifdef INFINITE_STATE_COVERAGE
+    if (to != at())
+      infinite_state_coverage_transition(at(), to);
+#endif
+    if (kind == transition_kind::local)
+      depth++;
+    else
+      enters.push_front(from);
+    auto exits = shift(depth, enters);
+    INFINITE_STATE_PROBE2(go__done, this, to);
     return {exits, enters};
   }
 
-  // Operation go(to) is the only mutator.
+  // Operation go is the only mutator.
   // The rest are query methods on the state vector.
 
   //! \brief Get the current state.
@@ -107,10 +357,157 @@ public:
   //! \param state The state to check.
   //! \return Answers \c true if the state is active, \c false otherwise.
   bool in(state<Topology> *state) const {
-    return std::find(states.cbegin(), states.cend(), state) != states.cend();
+    return find(state) != indices.cend();
+  }
+
+  //! \brief Get the number of active states.
+  size_type depth() const { return states.size(); }
+
+protected:
+  //! \brief Find the nesting level of an active state.
+  //! \param state The state to find.
+  //! \return The level, 0 for the outermost state, or the depth if the state
+  //! is not active.
+  size_type level(state<Topology> *state) const {
+    auto active = find(state);
+    return active == indices.cend() ? states.size() : active->second;
+  }
+
+  //! \brief Exit the active states nested deeper than a level.
+  //! \details Only pops the states; it neither walks the topology nor records
+  //! a transition.
+  //! \param depth The number of active states to keep.
+  //! \return The states exited, from sub to super.
+  std::deque<state<Topology> *> unwind(size_type depth) {
+    return shift(depth, {});
   }
 
 private:
+  //! \brief An active state and its nesting level.
+  using level_type = std::pair<state<Topology> *, size_type>;
+
+  //! \brief Find an active state's entry in the level map.
+  //! \param state The state to find.
+  //! \return The entry, or the end of the map if the state is not active.
+  typename std::vector<level_type>::const_iterator
+  find(state<Topology> *state) const {
+    auto at = bound(state);
+    return at != indices.cend() && at->first == state ? at : indices.cend();
+  }
+
+  //! \brief Find where a state's entry belongs in the sorted level map.
+  typename std::vector<level_type>::const_iterator
+  bound(state<Topology> *state) const {
+    using pointer = struct state<Topology> *;
+    return std::lower_bound(indices.cbegin(), indices.cend(), state,
+                            [](const level_type &entry, pointer key) {
+                              return std::less<pointer>()(entry.first, key);
+                            });
+  }
+
+  //! \brief Count the distinct states along a chain of super links.
+  //! \details Brent's cycle detection finds where a cyclic chain first
+  //! revisits a state using constant space, in place of a set of visited
+  //! states allocating a node per step.
+  //! \param to The first state, or \c nullptr.
+  //! \return The number of states before the chain ends or repeats.
+  static size_type chain(state<Topology> *to) {
+    if (to == nullptr)
+      return 0;
+    size_type power = 1, lambda = 1, steps = 1;
+    state<Topology> *tortoise = to, *hare = to->super;
+    for (; hare != tortoise; hare = hare->super, lambda++, steps++) {
+      if (hare == nullptr)
+        return steps;
+      if (power == lambda) {
+        tortoise = hare;
+        power *= 2;
+        lambda = 0;
+      }
+    }
+    // The cycle has length lambda; find where it starts.
+    tortoise = hare = to;
+    for (size_type step = 0; step < lambda; step++)
+      hare = hare->super;
+    size_type mu = 0;
+    for (; tortoise != hare; mu++) {
+      tortoise = tortoise->super;
+      hare = hare->super;
+    }
+    return mu + lambda;
+  }
+
+  //! \brief Pop the active states down to a depth, then push the enters.
+  //! \param depth The number of active states to keep.
+  //! \param enters The states to enter, from super to sub.
+  //! \return The states exited, from sub to super.
+  std::deque<state<Topology> *>
+  shift(size_type depth, const std::deque<state<Topology> *> &enters) {
+    std::deque<state<Topology> *> exits;
+    // Pop the active states below the depth, or all of them if none. The
+    // exits run from sub to super.
+    while (states.size() > depth) {
+      exits.push_back(states.back());
+      auto at = find(states.back());
+      if (at != indices.cend())
+        indices.erase(at);
+#ifdef INFINITE_STATE_COVERAGE
+      infinite_state_coverage_exit(states.back());
+#endif
+      states.pop_back();
+    }
+    for (auto enter : enters) {
+      auto at = bound(enter);
+      if (at == indices.cend() || at->first != enter)
+        indices.emplace(at, enter, states.size());
+      states.push_back(enter);
+#ifdef INFINITE_STATE_COVERAGE
+      infinite_state_coverage_enter(enter);
+#endif
+    }
+    return exits;
+  }
+
+  //! \brief Walk up from a new state to the least common ancestor.
+  //! \details Walks until reaching an active state nested directly within its
+  //! active super-state, or the root. An active state at a different nesting
+  //! is not common; it and everything nested within it exits and re-enters.
+  //! Stops also on revisiting a state; duplicates correspond to cyclic state
+  //! topologies. Counting the distinct states up front costs O(1) space,
+  //! unlike a set of visited states or searching the enters at every level.
+  //! \param to The new state, or \c nullptr.
+  //! \param enters The states to enter, filled from super to sub.
+  //! \return The number of active states to keep.
+  size_type walk(state<Topology> *to, std::deque<state<Topology> *> &enters) {
+    size_type nesting = states.size();
+    for (size_type span = chain(to); span > 0; span--, to = to->super) {
+      auto active = find(to);
+      if (active != indices.cend()) {
+        if (active->second < nesting &&
+            (active->second == 0 ? to->super == nullptr
+                                 : states[active->second - 1] == to->super))
+          return active->second + 1;
+        nesting = std::min(nesting, active->second);
+      }
+      enters.push_front(to);
+    }
+    return 0;
+  }
+
+  //! \brief Lift to the least common ancestor using the sealed index.
+  //! \details Jumps straight to the divergence point, then walks up from the
+  //! new state to it without look-ups or cycle detection; sealing has already
+  //! ruled out cycles.
+  //! \param to The new state, indexed.
+  //! \param enters The states to enter, filled from super to sub.
+  //! \return The number of active states to keep.
+  size_type lift(state<Topology> *to, std::deque<state<Topology> *> &enters) {
+    state<Topology> *lca = index->lca(states.back(), to);
+    for (; to != lca; to = to->super)
+      enters.push_front(to);
+    return lca ? index->depth(lca) + 1 : 0;
+  }
+
   //! \brief The deque holding the active states.
   //! \details This deque maintains the order of active states, allowing for
   //! efficient nested state transitions and queries.
@@ -121,6 +518,16 @@ private:
   //! \note This deque is not thread-safe and should be accessed
   //! only from a single thread.
   std::deque<state<Topology> *> states;
+
+  //! \brief Maps each active state to its index within the states deque.
+  //! \details A flat map sorted by state answers the least common ancestor,
+  //! and whether a state is active, in O(log d) time rather than by searching
+  //! the states. Its storage persists across transitions, so they allocate no
+  //! map nodes once the machine reaches its deepest nesting.
+  std::vector<level_type> indices;
+
+  //! \brief The optional sealed topology index.
+  const state_index<Topology> *index = nullptr;
 };
 
 } /* namespace infinite */
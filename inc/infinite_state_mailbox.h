@@ -0,0 +1,144 @@
+/*
+ * SPDX-FileCopyrightText: 2023, Roy Ratcliffe, Northumberland, United Kingdom
+ * SPDX-License-Identifier: MIT
+ */
+/*!
+ * \file infinite_state_mailbox.h
+ * \brief Interrupt and signal-safe event posting into a machine.
+ * \details A mailbox is a fixed-size ring of events for one machine. Posting
+ * is wait-free and async-signal-safe: a bounded number of lock-free atomic
+ * operations, no locks and no allocation. Interrupt handlers, signal handlers
+ * and other threads may all post concurrently. The machine's own loop drains
+ * the mailbox in batches, so posting never needs interrupts disabled around
+ * transitions.
+ *
+ * Each event goes to a state, with optional data. Draining either dispatches
+ * each event to a handler or, without one, goes to the states within a single
+ * transaction; a burst then exits and enters only the net difference. The
+ * caller supplies the ring's storage.
+ *
+ * Build with the CMake option \c INFINITE_MAILBOX, on targets with lock-free
+ * atomic integers.
+ */
+
+#ifndef INFINITE_STATE_MAILBOX_H
+#define INFINITE_STATE_MAILBOX_H
+
+#include "infinite_state_atomic.h"
+#include "infinite_state_machine.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * \brief Dispatches a drained event.
+ * \param machine The mailbox's machine.
+ * \param state The event's state.
+ * \param data The event's data.
+ * \param context The context given to the drain.
+ */
+typedef void (*infinite_state_mailbox_dispatch)(struct infinite_state_machine *machine,
+                                                const struct infinite_state *state, void *data, void *context);
+
+/*!
+ * \brief A slot within a mailbox's ring.
+ */
+struct infinite_state_mailbox_slot
+{
+    /*!
+     * \brief One more than the index of the event published in the slot.
+     */
+    INFINITE_STATE_ATOMIC(unsigned) sequence;
+
+    /*!
+     * \brief The event's state.
+     */
+    const struct infinite_state *state;
+
+    /*!
+     * \brief The event's data.
+     */
+    void *data;
+};
+
+/*!
+ * \brief A mailbox of events for a machine.
+ */
+struct infinite_state_mailbox
+{
+    /*!
+     * \brief The machine.
+     */
+    struct infinite_state_machine *machine;
+
+    /*!
+     * \brief The ring of slots.
+     */
+    struct infinite_state_mailbox_slot *slots;
+
+    /*!
+     * \brief The number of slots less one.
+     */
+    unsigned mask;
+
+    /*!
+     * \brief The number of slots claimed and not yet drained.
+     */
+    INFINITE_STATE_ATOMIC(unsigned) count;
+
+    /*!
+     * \brief The index of the next slot to claim.
+     */
+    INFINITE_STATE_ATOMIC(unsigned) tail;
+
+    /*!
+     * \brief The index of the next slot to drain; the machine's loop only.
+     */
+    unsigned head;
+};
+
+/*!
+ * \brief Initialises an empty mailbox.
+ * \param mailbox The mailbox.
+ * \param machine The machine to post into.
+ * \param slots The ring's storage.
+ * \param size The number of slots, a power of two.
+ * \return 0 on success, or a negative error code on failure; \c -EINVAL if the
+ * size is not a power of two.
+ */
+int infinite_state_mailbox_init(struct infinite_state_mailbox *mailbox, struct infinite_state_machine *machine,
+                                struct infinite_state_mailbox_slot *slots, unsigned size);
+
+/*!
+ * \brief Posts an event to a mailbox.
+ * Wait-free and async-signal-safe.
+ * \param mailbox The mailbox.
+ * \param state The state to go to.
+ * \param data The event's data, or \c NULL.
+ * \return 0 on success, or a negative error code on failure; \c -EAGAIN if the
+ * mailbox is full. Concurrent posting can fail while the mailbox is all but
+ * full.
+ */
+int infinite_state_mailbox_post(struct infinite_state_mailbox *mailbox, const struct infinite_state *state,
+                                void *data);
+
+/*!
+ * \brief Drains a batch of events from a mailbox.
+ * Stops at the first event claimed but not yet published. Dispatching may
+ * post further events; they drain in the same batch if it has room.
+ * \param mailbox The mailbox.
+ * \param batch The maximum number of events to drain.
+ * \param dispatch Dispatches each event, or \c NULL to go to each event's
+ * state within one transaction committed after the batch.
+ * \param context Context for the dispatch.
+ * \return The number of events drained.
+ */
+int infinite_state_mailbox_drain(struct infinite_state_mailbox *mailbox, int batch,
+                                 infinite_state_mailbox_dispatch dispatch, void *context);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INFINITE_STATE_MAILBOX_H */
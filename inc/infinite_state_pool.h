@@ -0,0 +1,229 @@
+/*
+ * SPDX-FileCopyrightText: 2023, Roy Ratcliffe, Northumberland, United Kingdom
+ * SPDX-License-Identifier: MIT
+ */
+/*!
+ * \file infinite_state_pool.h
+ * \brief Pooled, reference-counted event objects.
+ * \details Events carrying payloads, packets or sensor frames say, come from a
+ * pool of fixed-size classes carved from caller-supplied storage. Each event
+ * counts its references intrusively. Dispatching one event to many machines
+ * adds a reference per machine rather than copying the payload; the event
+ * returns to its pool when the last handler completes.
+ *
+ * Each thread caches free events per class, so that allocating and releasing
+ * rarely touch the pool's shared free lists. A thread's cache returns to the
+ * pool when the thread exits; until then it may hold up to
+ * \c{INFINITE_STATE_POOL_CACHE} free events per class, so size each class
+ * with that much slack per thread. Allocating and releasing are thread-safe but
+ * not async-signal-safe; post pooled events from signal handlers only if
+ * allocated beforehand. Build with the CMake option \c INFINITE_POOL.
+ */
+
+#ifndef INFINITE_STATE_POOL_H
+#define INFINITE_STATE_POOL_H
+
+#include "infinite_state_atomic.h"
+#include "infinite_state_mailbox.h"
+
+#include <pthread.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * \brief Maximum number of size classes in a pool.
+ * Defaults to 8 unless already defined when building the library.
+ */
+#ifndef INFINITE_STATE_POOL_CLASSES
+#define INFINITE_STATE_POOL_CLASSES 8
+#endif
+
+/*!
+ * \brief Maximum number of free events that each thread caches per class.
+ * Defaults to 32 unless already defined when building the library. Caches
+ * refill and drain by half this number at a time.
+ */
+#ifndef INFINITE_STATE_POOL_CACHE
+#define INFINITE_STATE_POOL_CACHE 32
+#endif
+
+struct infinite_state_pool;
+
+/*!
+ * \brief A pooled event; its payload follows.
+ */
+struct infinite_state_pool_event
+{
+    /*!
+     * \brief The number of references.
+     */
+    INFINITE_STATE_ATOMIC(unsigned) refs;
+
+    /*!
+     * \brief The index of the event's size class.
+     */
+    int bin;
+
+    /*!
+     * \brief The pool owning the event.
+     */
+    struct infinite_state_pool *pool;
+
+    /*!
+     * \brief The next free event, while free.
+     */
+    struct infinite_state_pool_event *next;
+};
+
+/*!
+ * \brief A size class: its payload size and its number of events.
+ */
+struct infinite_state_pool_class
+{
+    /*!
+     * \brief The payload size in bytes.
+     */
+    size_t size;
+
+    /*!
+     * \brief The number of events.
+     */
+    int count;
+};
+
+/*!
+ * \brief A pool of events.
+ */
+struct infinite_state_pool
+{
+    /*!
+     * \brief Guards the shared free lists.
+     */
+    pthread_mutex_t mutex;
+
+    /*!
+     * \brief Finds the calling thread's cache.
+     */
+    pthread_key_t key;
+
+    /*!
+     * \brief The number of size classes.
+     */
+    int bins;
+
+    /*!
+     * \brief The payload sizes by class, ascending.
+     */
+    size_t sizes[INFINITE_STATE_POOL_CLASSES];
+
+    /*!
+     * \brief The shared free lists by class.
+     */
+    struct infinite_state_pool_event *free[INFINITE_STATE_POOL_CLASSES];
+};
+
+/*!
+ * \brief Handles a pooled event drained from a mailbox.
+ * The event remains valid until the handler returns; take a reference to keep
+ * it longer.
+ * \param machine The mailbox's machine.
+ * \param state The event's state.
+ * \param event The pooled event.
+ * \param context The context given to the drain.
+ */
+typedef void (*infinite_state_pool_handler)(struct infinite_state_machine *machine,
+                                            const struct infinite_state *state,
+                                            struct infinite_state_pool_event *event, void *context);
+
+/*!
+ * \brief Computes the storage needed by a pool's size classes.
+ * \param classes The size classes.
+ * \param count The number of size classes.
+ * \return The size in bytes.
+ */
+size_t infinite_state_pool_size(const struct infinite_state_pool_class classes[], int count);
+
+/*!
+ * \brief Initialises a pool, carving its events from storage.
+ * \param pool The pool.
+ * \param classes The size classes, by ascending payload size.
+ * \param count The number of size classes, at most
+ * \c{INFINITE_STATE_POOL_CLASSES}.
+ * \param storage The storage, aligned to \c{INFINITE_STATE_ALIGNMENT}.
+ * \param size The size of the storage in bytes, at least
+ * \c{infinite_state_pool_size()}.
+ * \return 0 on success, or a negative error code on failure.
+ */
+int infinite_state_pool_init(struct infinite_state_pool *pool, const struct infinite_state_pool_class classes[],
+                             int count, void *storage, size_t size);
+
+/*!
+ * \brief Destroys a pool.
+ * Other threads must have finished with the pool and exited, or never used
+ * it; the calling thread's cache returns to the pool first.
+ * \param pool The pool.
+ */
+void infinite_state_pool_destroy(struct infinite_state_pool *pool);
+
+/*!
+ * \brief Allocates an event from the smallest class that fits.
+ * \param pool The pool.
+ * \param size The payload size in bytes.
+ * \return The event with one reference, or \c NULL if no class fits or the
+ * fitting class has no free events.
+ */
+struct infinite_state_pool_event *infinite_state_pool_alloc(struct infinite_state_pool *pool, size_t size);
+
+/*!
+ * \brief Gets an event's payload.
+ * \param event The event.
+ * \return The payload, aligned to \c{INFINITE_STATE_ALIGNMENT}.
+ */
+void *infinite_state_pool_payload(struct infinite_state_pool_event *event);
+
+/*!
+ * \brief Adds a reference to an event.
+ * \param event The event.
+ */
+void infinite_state_pool_ref(struct infinite_state_pool_event *event);
+
+/*!
+ * \brief Releases a reference to an event.
+ * The last release returns the event to the calling thread's cache.
+ * \param event The event.
+ */
+void infinite_state_pool_unref(struct infinite_state_pool_event *event);
+
+/*!
+ * \brief Posts one event to many mailboxes without copying it.
+ * Adds a reference for each mailbox posted to. The caller keeps its own
+ * reference.
+ * \param mailboxes The mailboxes.
+ * \param count The number of mailboxes.
+ * \param state The state to go to.
+ * \param event The event.
+ * \return The number of mailboxes posted to; full mailboxes are skipped.
+ */
+int infinite_state_pool_post(struct infinite_state_mailbox *const mailboxes[], int count,
+                             const struct infinite_state *state, struct infinite_state_pool_event *event);
+
+/*!
+ * \brief Drains a batch of pooled events from a mailbox.
+ * Releases each event's mailbox reference once its handler completes.
+ * \param mailbox The mailbox, posted to only with pooled events.
+ * \param batch The maximum number of events to drain.
+ * \param handler Handles each event.
+ * \param context Context for the handler.
+ * \return The number of events drained.
+ */
+int infinite_state_pool_drain(struct infinite_state_mailbox *mailbox, int batch, infinite_state_pool_handler handler,
+                              void *context);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INFINITE_STATE_POOL_H */
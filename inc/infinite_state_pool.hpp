@@ -0,0 +1,95 @@
+// SPDX-License-Identifier: MIT
+//! \file infinite_state_pool.hpp
+//! \details This file contains a reference-counting handle to pooled events
+//! for the C++ engine. Copying a handle adds a reference rather than copying
+//! the payload; destroying the last handle returns the event to its pool.
+
+#ifndef INFINITE_STATE_POOL_HPP_
+#define INFINITE_STATE_POOL_HPP_
+
+#include "infinite_state_pool.h"
+
+// for placement new
+#include <new>
+// for trivially destructible payloads
+#include <type_traits>
+// for exchange and swap
+#include <utility>
+
+namespace infinite {
+
+//! \brief A counted reference to a pooled event.
+//! \details Pass handles by value to each machine's handler; the payload lives
+//! until every handler has finished with it.
+//! \tparam Payload The payload type; no destructor ever runs.
+template <typename Payload> class pooled {
+  static_assert(std::is_trivially_destructible_v<Payload>,
+                "pooled payloads return to the pool without destruction");
+  static_assert(alignof(Payload) <= INFINITE_STATE_ALIGNMENT,
+                "pooled payloads align only to INFINITE_STATE_ALIGNMENT");
+
+public:
+  pooled() = default;
+
+  //! \brief Allocate an event for a payload from a pool.
+  //! \details Value-initialises the payload, running its constructor and
+  //! default member initialisers. The handle is empty if the pool has no event
+  //! large enough.
+  //! \param pool The pool.
+  explicit pooled(infinite_state_pool *pool)
+      : event(infinite_state_pool_alloc(pool, sizeof(Payload))) {
+    if (event)
+      new (infinite_state_pool_payload(event)) Payload();
+  }
+
+  //! \brief Adopt an event's reference.
+  //! \param event The event.
+  explicit pooled(infinite_state_pool_event *event) : event(event) {}
+
+  pooled(const pooled &other) : event(other.event) {
+    if (event)
+      infinite_state_pool_ref(event);
+  }
+
+  pooled(pooled &&other) noexcept : event(std::exchange(other.event, nullptr)) {}
+
+  pooled &operator=(pooled other) noexcept {
+    std::swap(event, other.event);
+    return *this;
+  }
+
+  ~pooled() {
+    if (event)
+      infinite_state_pool_unref(event);
+  }
+
+  explicit operator bool() const { return event != nullptr; }
+
+  Payload *operator->() const { return get(); }
+
+  Payload &operator*() const { return *get(); }
+
+  //! \brief Get the payload.
+  //! \return The payload, or \c nullptr if the handle is empty.
+  Payload *get() const {
+    return event ? static_cast<Payload *>(infinite_state_pool_payload(event))
+                 : nullptr;
+  }
+
+  //! \brief Get the event, to post it to mailboxes say.
+  //! \return The event, or \c nullptr if the handle is empty.
+  infinite_state_pool_event *handle() const { return event; }
+
+  //! \brief Hand the reference over to C code without releasing it.
+  //! \return The event; release it with \c{infinite_state_pool_unref()}.
+  infinite_state_pool_event *release() {
+    return std::exchange(event, nullptr);
+  }
+
+private:
+  infinite_state_pool_event *event = nullptr;
+};
+
+} // namespace infinite
+
+#endif // INFINITE_STATE_POOL_HPP_
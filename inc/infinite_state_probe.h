@@ -0,0 +1,46 @@
+/*
+ * SPDX-FileCopyrightText: 2023, Roy Ratcliffe, Northumberland, United Kingdom
+ * SPDX-License-Identifier: MIT
+ */
+/*!
+ * \file infinite_state_probe.h
+ * \brief Static tracepoints for the infinite state machine.
+ * \details Defines USDT (user-level statically-defined tracing) probes using
+ * \c{<sys/sdt.h>} when \c INFINITE_STATE_MACHINE_USDT is defined and the header
+ * exists; otherwise the probes compile to nothing. A compiled-in probe is a
+ * single no-op instruction until a tracer such as bpftrace or perf attaches.
+ *
+ * The provider is \c infinite. The probes are:
+ *  - \c enter (machine, state, depth) after pushing a state;
+ *  - \c exit (machine, state, depth) after popping a state;
+ *  - \c goto__start (machine, from, to) and \c goto__done (machine, to)
+ *    around each transition that a C machine takes, once per commit pass
+ *    however requested, and around the direct step of a transition by kind;
+ *  - \c go__start (machine, from, to) and \c go__done (machine, to) around
+ *    the C++ \c{state_machine::go()}.
+ *
+ * For example, to histogram goto latency:
+ * \code
+ * bpftrace -e 'usdt:./app:infinite:goto__start { @s[tid] = nsecs; }
+ *   usdt:./app:infinite:goto__done /@s[tid]/ {
+ *     @ns = hist(nsecs - @s[tid]); delete(@s[tid]); }'
+ * \endcode
+ */
+
+#ifndef INFINITE_STATE_PROBE_H
+#define INFINITE_STATE_PROBE_H
+
+#if defined(INFINITE_STATE_MACHINE_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define INFINITE_STATE_PROBE2(name, arg1, arg2) STAP_PROBE2(infinite, name, arg1, arg2)
+#define INFINITE_STATE_PROBE3(name, arg1, arg2, arg3) STAP_PROBE3(infinite, name, arg1, arg2, arg3)
+#endif
+#endif
+
+#ifndef INFINITE_STATE_PROBE2
+#define INFINITE_STATE_PROBE2(name, arg1, arg2) ((void)0)
+#define INFINITE_STATE_PROBE3(name, arg1, arg2, arg3) ((void)0)
+#endif
+
+#endif /* INFINITE_STATE_PROBE_H */
@@ -0,0 +1,83 @@
+/*
+ * SPDX-FileCopyrightText: 2023, Roy Ratcliffe, Northumberland, United Kingdom
+ * SPDX-License-Identifier: MIT
+ */
+/*!
+ * \file infinite_state_profile.h
+ * \brief Sampling profiler attributing CPU time to active state paths.
+ * \details A profiling timer periodically interrupts each running thread. The
+ * signal handler reads the thread's currently dispatching machine and counts a
+ * sample against its path of active states, outer to inner. Dumping the counts
+ * as folded stacks feeds flame graph tools directly, showing which states
+ * rather than which functions burn CPU.
+ *
+ * Goto publishes its machine for the duration of the transition, including
+ * all enter and exit actions. Event dispatch loops publish their machine
+ * likewise using \c{infinite_state_profile_machine}, at the cost of one
+ * thread-local store per dispatch.
+ *
+ * POSIX only: the profiler uses \c SIGPROF and \c{setitimer()}. The handler
+ * is async-signal-safe; it never allocates, and a fixed-size table holds the
+ * counts. Build with the CMake option \c INFINITE_PROFILE.
+ */
+
+#ifndef INFINITE_STATE_PROFILE_H
+#define INFINITE_STATE_PROFILE_H
+
+#include "infinite_state_machine.h"
+
+#include <stdio.h>
+
+/*!
+ * \brief Number of distinct state paths the profiler can count.
+ * Defaults to 1024 unless already defined before the inclusion point of this
+ * header and when building the library.
+ */
+#ifndef INFINITE_STATE_PROFILE_PATHS
+#define INFINITE_STATE_PROFILE_PATHS 1024
+#endif
+
+/*!
+ * \brief The calling thread's currently dispatching machine, or \c NULL.
+ * Samples taken while \c NULL count against no path.
+ */
+extern _Thread_local const struct infinite_state_machine *infinite_state_profile_machine;
+
+/*!
+ * \brief Starts sampling.
+ * Installs the \c SIGPROF handler, saving the previous one, and arms the
+ * process's profiling timer.
+ * \param hz The sampling frequency in samples per second of CPU time.
+ * \return 0 on success, or a negative error code on failure.
+ */
+int infinite_state_profile_start(int hz);
+
+/*!
+ * \brief Stops sampling.
+ * Disarms the profiling timer and restores the previous \c SIGPROF handler.
+ * The counts remain until reset.
+ */
+void infinite_state_profile_stop(void);
+
+/*!
+ * \brief Discards all counts.
+ * \note Stop sampling first.
+ */
+void infinite_state_profile_reset(void);
+
+/*!
+ * \brief Gets the number of samples dropped because the table was full.
+ */
+unsigned long infinite_state_profile_dropped(void);
+
+/*!
+ * \brief Dumps the counts as folded stacks.
+ * Writes one line per state path: the states from outer to inner separated by
+ * semicolons, a space, then the sample count.
+ * \param file The file to write to.
+ * \param name Names a state, or \c NULL to write state addresses.
+ * \return The number of paths written, or a negative error code on failure.
+ */
+int infinite_state_profile_dump(FILE *file, const char *(*name)(const struct infinite_state *state));
+
+#endif /* INFINITE_STATE_PROFILE_H */
@@ -0,0 +1,191 @@
+/*
+ * SPDX-FileCopyrightText: 2023, Roy Ratcliffe, Northumberland, United Kingdom
+ * SPDX-License-Identifier: MIT
+ */
+/*!
+ * \file infinite_state_reactor.h
+ * \brief Readiness reactor feeding file descriptor events into machines.
+ * \details Associates file descriptors with infinite state machines and
+ * dispatches their readiness events, in batches, to a handler that applies
+ * the corresponding transitions. Linux only, using epoll. Build with the CMake
+ * option \c INFINITE_REACTOR.
+ *
+ * Run one reactor per core, each on its own thread and owning its own sources;
+ * reactors share nothing, so dispatching never locks. The caller owns every
+ * source, typically embedding it within a session alongside the session's
+ * machine, so that neither adding a source nor dispatching its events
+ * allocates.
+ */
+
+#ifndef INFINITE_STATE_REACTOR_H
+#define INFINITE_STATE_REACTOR_H
+
+#include "infinite_state_machine.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * \brief Maximum number of events dispatched per wait.
+ * Defaults to 64 unless already defined when building the library.
+ */
+#ifndef INFINITE_STATE_REACTOR_BATCH
+#define INFINITE_STATE_REACTOR_BATCH 64
+#endif
+
+/*!
+ * \name Reactor events
+ * Events of interest when adding a source, and events ready when dispatching.
+ * Hang-ups and errors always dispatch, whether of interest or not.
+ * \{
+ */
+#define INFINITE_STATE_REACTOR_READ 0x1U
+#define INFINITE_STATE_REACTOR_WRITE 0x2U
+#define INFINITE_STATE_REACTOR_HANGUP 0x4U
+#define INFINITE_STATE_REACTOR_ERROR 0x8U
+/*! \} */
+
+struct infinite_state_reactor_source;
+
+/*!
+ * \brief Handles a source's ready events.
+ * Typically reads or writes the file descriptor until it would block, then
+ * transitions the source's machine. The handler may modify or remove any
+ * source of the same reactor, its own included, and may stop the reactor.
+ * \param source The ready source.
+ * \param events The ready events.
+ */
+typedef void (*infinite_state_reactor_dispatch)(struct infinite_state_reactor_source *source, unsigned events);
+
+/*!
+ * \brief A file descriptor associated with a machine.
+ * The caller owns the source and keeps it in place while added to a reactor.
+ */
+struct infinite_state_reactor_source
+{
+    /*!
+     * \brief The file descriptor, ordinarily non-blocking.
+     */
+    int fd;
+
+    /*!
+     * \brief The machine driven by the file descriptor's events.
+     */
+    struct infinite_state_machine *machine;
+
+    /*!
+     * \brief The handler of the file descriptor's events.
+     */
+    infinite_state_reactor_dispatch dispatch;
+};
+
+/*!
+ * \brief A reactor, one per core.
+ */
+struct infinite_state_reactor
+{
+    /*!
+     * \brief The epoll file descriptor.
+     */
+    int epoll;
+
+    /*!
+     * \brief The event file descriptor that wakes the reactor to stop it.
+     */
+    int wake;
+
+    /*!
+     * \brief The batch of events being dispatched, or \c NULL between batches.
+     * \note Removing a source cancels any of its events still pending in the
+     * batch.
+     */
+    void *batch;
+
+    /*!
+     * \brief The number of events in the batch.
+     */
+    int count;
+};
+
+/*!
+ * \brief Initialises a reactor.
+ * \param reactor The reactor.
+ * \return 0 on success, or a negative error code on failure.
+ */
+int infinite_state_reactor_init(struct infinite_state_reactor *reactor);
+
+/*!
+ * \brief Closes a reactor's file descriptors.
+ * Leaves the sources' file descriptors open.
+ * \param reactor The reactor.
+ */
+void infinite_state_reactor_close(struct infinite_state_reactor *reactor);
+
+/*!
+ * \brief Adds a source to a reactor.
+ * \param reactor The reactor.
+ * \param source The source, with its file descriptor, machine and handler.
+ * \param events The events of interest.
+ * \return 0 on success, or a negative error code on failure.
+ */
+int infinite_state_reactor_add(struct infinite_state_reactor *reactor, struct infinite_state_reactor_source *source,
+                               unsigned events);
+
+/*!
+ * \brief Changes the events of interest of an added source.
+ * \param reactor The reactor.
+ * \param source The source.
+ * \param events The events of interest.
+ * \return 0 on success, or a negative error code on failure.
+ */
+int infinite_state_reactor_modify(struct infinite_state_reactor *reactor, struct infinite_state_reactor_source *source,
+                                  unsigned events);
+
+/*!
+ * \brief Removes a source from a reactor.
+ * Remove a source before closing its file descriptor.
+ * \param reactor The reactor.
+ * \param source The source.
+ * \return 0 on success, or a negative error code on failure.
+ */
+int infinite_state_reactor_remove(struct infinite_state_reactor *reactor, struct infinite_state_reactor_source *source);
+
+/*!
+ * \brief Waits for one batch of events and dispatches it.
+ * \param reactor The reactor.
+ * \param timeout The longest wait in milliseconds, 0 to poll, or -1 to wait
+ * indefinitely.
+ * \return The number of events dispatched, or a negative error code on
+ * failure; \c -ECANCELED if stopped.
+ */
+int infinite_state_reactor_poll(struct infinite_state_reactor *reactor, int timeout);
+
+/*!
+ * \brief Dispatches batches of events until stopped.
+ * \param reactor The reactor.
+ * \return 0 when stopped, or a negative error code on failure.
+ */
+int infinite_state_reactor_run(struct infinite_state_reactor *reactor);
+
+/*!
+ * \brief Stops a reactor.
+ * Safe to call from any thread, or from a signal handler. The reactor stops
+ * after dispatching its current batch.
+ * \param reactor The reactor.
+ */
+void infinite_state_reactor_stop(struct infinite_state_reactor *reactor);
+
+/*!
+ * \brief Pins the calling thread to a core.
+ * Run each reactor on its own pinned thread.
+ * \param core The core, from 0.
+ * \return 0 on success, or a negative error code on failure.
+ */
+int infinite_state_reactor_pin(int core);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INFINITE_STATE_REACTOR_H */
@@ -0,0 +1,173 @@
+/*
+ * SPDX-FileCopyrightText: 2023, Roy Ratcliffe, Northumberland, United Kingdom
+ * SPDX-License-Identifier: MIT
+ */
+/*!
+ * \file infinite_state_simulator.h
+ * \brief Deterministic discrete-event simulation in virtual time.
+ * \details Drives any number of machines by firing scheduled events, timer
+ * expiries and posted events alike, in timestamp order against a virtual
+ * clock. The clock jumps straight to the next event, skipping idle time, so
+ * simulations run as fast as their actions allow.
+ *
+ * Runs are deterministic. Events at the same time fire in the order scheduled,
+ * and nothing depends on the wall clock. The caller supplies the event queue's
+ * storage; scheduling never allocates.
+ */
+
+#ifndef INFINITE_STATE_SIMULATOR_H
+#define INFINITE_STATE_SIMULATOR_H
+
+#include "infinite_state_machine.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct infinite_state_simulator;
+struct infinite_state_simulator_event;
+
+/*!
+ * \brief Fires an event.
+ * Typically transitions the event's machine, and may schedule further events.
+ * \param simulator The simulator, its clock at the event's time.
+ * \param event The event, a copy no longer queued.
+ */
+typedef void (*infinite_state_simulator_fire)(struct infinite_state_simulator *simulator,
+                                              const struct infinite_state_simulator_event *event);
+
+/*!
+ * \brief A scheduled event.
+ */
+struct infinite_state_simulator_event
+{
+    /*!
+     * \brief The virtual time at which the event fires.
+     */
+    uint64_t time;
+
+    /*!
+     * \brief The scheduling order, breaking ties between events at the same
+     * time.
+     */
+    uint64_t sequence;
+
+    /*!
+     * \brief The machine driven by the event.
+     */
+    struct infinite_state_machine *machine;
+
+    /*!
+     * \brief The state that must be active for the event to fire, or \c NULL.
+     * \note A timeout guarded by its state expires harmlessly once the machine
+     * leaves the state, without cancelling. Build with
+     * \c{INFINITE_STATE_ACTIVATIONS} and attach activation counts to the
+     * machine, see \c{infinite_state_machine_activations()}, for the timeout
+     * also to expire harmlessly if the machine re-enters the state before
+     * expiry; otherwise it fires in the new activation.
+     */
+    const struct infinite_state *state;
+
+#ifdef INFINITE_STATE_ACTIVATIONS
+    /*!
+     * \brief The guard state's activation count when scheduled.
+     * The event fires only if the count still matches; 0 if the machine counts
+     * no activations.
+     */
+    unsigned long activation;
+#endif
+
+    /*!
+     * \brief The action firing the event.
+     */
+    infinite_state_simulator_fire fire;
+
+    /*!
+     * \brief Context for the action.
+     */
+    void *context;
+};
+
+/*!
+ * \brief A simulator.
+ */
+struct infinite_state_simulator
+{
+    /*!
+     * \brief The virtual time now, in caller-defined units.
+     */
+    uint64_t now;
+
+    /*!
+     * \brief The sequence number of the next scheduled event.
+     */
+    uint64_t sequence;
+
+    /*!
+     * \brief The queued events, a binary min-heap ordered by time then
+     * sequence.
+     */
+    struct infinite_state_simulator_event *events;
+
+    /*!
+     * \brief The number of queued events.
+     */
+    int count;
+
+    /*!
+     * \brief The capacity of the event queue.
+     */
+    int size;
+};
+
+/*!
+ * \brief Initialises a simulator at time 0.
+ * \param simulator The simulator.
+ * \param events Storage for the event queue.
+ * \param size The capacity of \p events.
+ */
+void infinite_state_simulator_init(struct infinite_state_simulator *simulator,
+                                   struct infinite_state_simulator_event *events, int size);
+
+/*!
+ * \brief Schedules an event after a delay.
+ * \param simulator The simulator.
+ * \param delay The delay from now; 0 posts the event to fire after those
+ * already due now.
+ * \param machine The machine driven by the event.
+ * \param state The state guarding the event, or \c NULL.
+ * \param fire The action firing the event.
+ * \param context Context for the action.
+ * \return The event's sequence number, or a negative error code on failure;
+ * \c -ENOMEM if the queue is full.
+ */
+int64_t infinite_state_simulator_schedule(struct infinite_state_simulator *simulator, uint64_t delay,
+                                          struct infinite_state_machine *machine, const struct infinite_state *state,
+                                          infinite_state_simulator_fire fire, void *context);
+
+/*!
+ * \brief Fires the next event, advancing the clock to its time.
+ * An event whose guard state is no longer active, or, counting activations,
+ * is active again in a later activation, advances the clock but does not
+ * fire.
+ * \param simulator The simulator.
+ * \return 1 if an event fired, 0 if one expired unfired, or \c -ENOENT if none
+ * remain.
+ */
+int infinite_state_simulator_step(struct infinite_state_simulator *simulator);
+
+/*!
+ * \brief Fires events up to a time, then advances the clock to that time.
+ * \param simulator The simulator.
+ * \param until The virtual time to run until, inclusive.
+ * \return The number of events fired.
+ */
+uint64_t infinite_state_simulator_run(struct infinite_state_simulator *simulator, uint64_t until);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INFINITE_STATE_SIMULATOR_H */
@@ -0,0 +1,102 @@
+/*
+ * SPDX-FileCopyrightText: 2023, Roy Ratcliffe, Northumberland, United Kingdom
+ * SPDX-License-Identifier: MIT
+ */
+/*!
+ * \file infinite_state_wcet.h
+ * \brief Worst-case step analysis for bounded real-time transitions.
+ * \details Real-time machines never recurse: topology walks iterate, and
+ * actions that go to another state only request the transition, which the
+ * committing transaction performs next. Analysing a transition from every
+ * possible active configuration bounds the exit and enter actions run, and
+ * the commit passes taken, including completion transitions. Each pass walks
+ * at most the maximum depth of super links. Multiply by the actions' own worst
+ * cases to budget a control cycle.
+ *
+ * The analysis covers only what the topology declares: the target, initial
+ * sub-states and completions. Transitions that actions request at run time
+ * are invisible to it. Each such request adds a pass and the steps of going
+ * to the requested state; analyse that state too and budget the chain of
+ * requests separately. For example, an enter action of the target requesting
+ * another state costs a second pass beyond the reported worst case.
+ *
+ * Build with the CMake option \c INFINITE_REALTIME, which defines
+ * \c INFINITE_STATE_REALTIME for the library and its users, and reports each
+ * engine function's stack usage against a budget.
+ */
+
+#ifndef INFINITE_STATE_WCET_H
+#define INFINITE_STATE_WCET_H
+
+#include "infinite_state.h"
+
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * \brief Worst-case steps of going to a state.
+ */
+struct infinite_state_wcet
+{
+    /*!
+     * \brief The most exit actions run.
+     */
+    int exits;
+
+    /*!
+     * \brief The most enter actions run.
+     */
+    int enters;
+
+    /*!
+     * \brief The most commit passes, one plus the completion transitions.
+     */
+    int passes;
+
+    /*!
+     * \brief The most exit and enter actions run together.
+     */
+    int steps;
+};
+
+/*!
+ * \brief Analyses the worst case of going to a state.
+ * Considers an empty machine plus each state of the topology as the innermost
+ * active state, its initial sub-states entered. Excludes transitions requested
+ * by actions.
+ * \param states The topology's states.
+ * \param count The number of states.
+ * \param max_depth The machine's maximum depth, at most
+ * \c{INFINITE_STATE_MACHINE_MAX_DEPTH}.
+ * \param target The state to go to, or \c NULL.
+ * \param wcet The worst case.
+ * \return The worst-case steps, or a negative error code on failure; \c -ELOOP
+ * if completion transitions never end, or \c -ENOMEM if the target or a
+ * completion is deeper than the machine.
+ */
+int infinite_state_wcet(const struct infinite_state *const states[], int count, int max_depth,
+                        const struct infinite_state *target, struct infinite_state_wcet *wcet);
+
+/*!
+ * \brief Reports the worst case of going to each state of a topology.
+ * Writes a header line, then one line per state: its name followed by its
+ * worst-case exits, enters, passes and steps separated by spaces.
+ * \param file The file to write to.
+ * \param states The topology's states.
+ * \param count The number of states.
+ * \param max_depth The machine's maximum depth.
+ * \param name Names a state, or \c NULL to write state addresses.
+ * \return The worst-case steps across all states, or a negative error code on
+ * failure.
+ */
+int infinite_state_wcet_report(FILE *file, const struct infinite_state *const states[], int count, int max_depth,
+                               const char *(*name)(const void *state));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INFINITE_STATE_WCET_H */
@@ -6,8 +6,8 @@
  * \file infinite_state.c
  * \brief Implementation of infinite state machine topology traversal.
  *
- * The \c infinite_state_topology() function performs a depth-limited upward
- * traversal of the state hierarchy, collecting unique super-states (including
+ * The \c infinite_state_topology() function performs a depth-limited iterative
+ * upward traversal of the state hierarchy, collecting unique super-states (including
  * the starting state) into the supplied topology array. The function returns a
  * pointer to the next free slot after the last written state. Duplicate
  * suppression (to avoid loops) is compiled in only when \c DEBUG is defined.
@@ -27,31 +27,72 @@
 
 #include "infinite_state.h"
 
-#include <stddef.h>
+/*
+ * The amalgamation cannot define the base in every translation unit that
+ * includes it; one of them defines it instead.
+ */
+#if INFINITE_STATE_REF_BITS && !defined(INFINITE_STATE_AMALGAMATION)
+const void *infinite_state_base;
+#endif
 
-struct infinite_state **infinite_state_topology(struct infinite_state *state, int depth,
-                                                struct infinite_state **topology)
+INFINITE_STATE_API const struct infinite_state **infinite_state_topology(const struct infinite_state *state, int depth,
+                                                                         const struct infinite_state **topology)
 {
     /*
-     * Get the topology of the infinite state machine.
-     * This function traverses the state hierarchy and collects all states
-     * in the specified topology array.
+     * Collect the state and its super-states from the inside out, at most
+     * depth of them, then reverse them into forward order. Iterating rather
+     * than recursing bounds the stack whatever the depth.
      */
-    if (state == NULL || depth == 0)
+    int count = 0;
+    for (; state != NULL && count < depth; state = INFINITE_STATE_DEREF(state->super))
+    {
+        topology[count++] = state;
+    }
+    for (int sub = count - 1, super = 0; super < sub; sub--, super++)
     {
-        return topology;
+        const struct infinite_state *swap = topology[super];
+        topology[super] = topology[sub];
+        topology[sub] = swap;
     }
-    struct infinite_state **sub = infinite_state_topology(state->super, depth - 1, topology);
 #ifdef DEBUG
-    for (struct infinite_state **super = topology; super != sub; super++)
+    /*
+     * Drop any state that repeats one of its super-states; repeats correspond
+     * to cyclic topologies.
+     */
+    int unique = 0;
+    for (int index = 0; index < count; index++)
     {
-        if (*super == state)
+        int repeat = 0;
+        for (int super = 0; super < unique && !repeat; super++)
         {
-            // If we found the state in the super-states, we need to stop.
-            return sub;
+            repeat = topology[super] == topology[index];
+        }
+        if (!repeat)
+        {
+            topology[unique++] = topology[index];
         }
     }
+    count = unique;
 #endif
-    *sub = state;
-    return sub + 1;
+    return topology + count;
+}
+
+INFINITE_STATE_API int infinite_state_depth(const struct infinite_state *state, int depth)
+{
+    int count = 0;
+    for (; state != NULL && count < depth; state = INFINITE_STATE_DEREF(state->super))
+    {
+        count++;
+    }
+    return count;
+}
+
+INFINITE_STATE_API size_t infinite_state_size(const struct infinite_state *state, int depth)
+{
+    size_t size = 0;
+    for (; state != NULL && depth > 0; state = INFINITE_STATE_DEREF(state->super), depth--)
+    {
+        size += INFINITE_STATE_ALIGN(state->size);
+    }
+    return size;
 }
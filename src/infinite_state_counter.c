@@ -0,0 +1,232 @@
+/*
+ * SPDX-FileCopyrightText: 2023, Roy Ratcliffe, Northumberland, United Kingdom
+ * SPDX-License-Identifier: MIT
+ */
+/*!
+ * \file infinite_state_counter.c
+ * \brief Transition-frequency counter implementation.
+ *
+ * Each shard is an open-addressed hash table owned by one thread. Only the
+ * owner writes a slot's key, before publishing the slot with release
+ * semantics; counts are relaxed atomics. Merging therefore reads shards
+ * concurrently with their owners, seeing each count at some recent value.
+ *
+ * Shards stay on the list for good. A thread-specific key's destructor releases
+ * an exiting thread's shard, counts intact, for the next new thread to claim.
+ */
+
+#include "infinite_state_counter.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+struct pair
+{
+    atomic_int used;
+    const void *from;
+    const void *to;
+    atomic_ulong count;
+};
+
+struct shard
+{
+    struct shard *next;
+    atomic_int owned;
+    struct pair pairs[INFINITE_STATE_COUNTER_PAIRS];
+};
+
+static _Thread_local struct shard *local;
+
+static _Atomic(struct shard *) shards;
+
+static atomic_ulong dropped;
+
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+static pthread_key_t key;
+
+static int keyed;
+
+/*
+ * Releases an exiting thread's shard. Releasing orders the thread's writes to
+ * the shard before the next owner's claim.
+ */
+static void infinite_state_counter_release(void *specific)
+{
+    struct shard *shard = specific;
+    atomic_store_explicit(&shard->owned, 0, memory_order_release);
+}
+
+static void infinite_state_counter_key(void)
+{
+    keyed = pthread_key_create(&key, infinite_state_counter_release) == 0;
+}
+
+/*
+ * Claims a released shard, or allocates and publishes a new one; NULL if out
+ * of memory.
+ */
+static struct shard *infinite_state_counter_claim(void)
+{
+    (void)pthread_once(&once, infinite_state_counter_key);
+    struct shard *shard = atomic_load_explicit(&shards, memory_order_acquire);
+    for (; shard != NULL; shard = shard->next)
+    {
+        int owned = 0;
+        if (atomic_compare_exchange_strong_explicit(&shard->owned, &owned, 1, memory_order_acquire,
+                                                    memory_order_relaxed))
+        {
+            break;
+        }
+    }
+    if (shard == NULL)
+    {
+        if ((shard = calloc(1, sizeof(*shard))) == NULL)
+        {
+            return NULL;
+        }
+        atomic_init(&shard->owned, 1);
+        shard->next = atomic_load_explicit(&shards, memory_order_relaxed);
+        while (!atomic_compare_exchange_weak_explicit(&shards, &shard->next, shard, memory_order_release,
+                                                      memory_order_relaxed))
+        {
+        }
+    }
+    /*
+     * Without a key, the shard stays owned after the thread exits.
+     */
+    if (keyed)
+    {
+        (void)pthread_setspecific(key, shard);
+    }
+    return shard;
+}
+
+static size_t infinite_state_counter_hash(const void *from, const void *to)
+{
+    size_t hash = (size_t)from * 31 + (size_t)to;
+    return hash ^ (hash >> 7);
+}
+
+void infinite_state_counter_record(const void *from, const void *to)
+{
+    struct shard *shard = local;
+    if (shard == NULL)
+    {
+        if ((shard = infinite_state_counter_claim()) == NULL)
+        {
+            atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+            return;
+        }
+        local = shard;
+    }
+    size_t hash = infinite_state_counter_hash(from, to);
+    for (int probe = 0; probe < INFINITE_STATE_COUNTER_PAIRS; probe++)
+    {
+        struct pair *pair = shard->pairs + (hash + probe) % INFINITE_STATE_COUNTER_PAIRS;
+        if (!atomic_load_explicit(&pair->used, memory_order_relaxed))
+        {
+            pair->from = from;
+            pair->to = to;
+            atomic_store_explicit(&pair->count, 1, memory_order_relaxed);
+            atomic_store_explicit(&pair->used, 1, memory_order_release);
+            return;
+        }
+        if (pair->from == from && pair->to == to)
+        {
+            atomic_fetch_add_explicit(&pair->count, 1, memory_order_relaxed);
+            return;
+        }
+    }
+    atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+}
+
+int infinite_state_counter_merge(struct infinite_state_counter *counters, int size)
+{
+    int merged = 0;
+    for (struct shard *shard = atomic_load_explicit(&shards, memory_order_acquire); shard != NULL;
+         shard = shard->next)
+    {
+        for (int index = 0; index < INFINITE_STATE_COUNTER_PAIRS; index++)
+        {
+            struct pair *pair = shard->pairs + index;
+            if (!atomic_load_explicit(&pair->used, memory_order_acquire))
+            {
+                continue;
+            }
+            unsigned long count = atomic_load_explicit(&pair->count, memory_order_relaxed);
+            int counter = 0;
+            while (counter < merged && counter < size &&
+                   (counters[counter].from != pair->from || counters[counter].to != pair->to))
+            {
+                counter++;
+            }
+            if (counter < merged && counter < size)
+            {
+                counters[counter].count += count;
+                continue;
+            }
+            if (merged < size)
+            {
+                counters[merged].from = pair->from;
+                counters[merged].to = pair->to;
+                counters[merged].count = count;
+            }
+            merged++;
+        }
+    }
+    return merged;
+}
+
+int infinite_state_counter_dump(FILE *file, const char *(*name)(const void *state))
+{
+    int size = infinite_state_counter_merge(NULL, 0);
+    struct infinite_state_counter *counters = calloc(size > 0 ? size : 1, sizeof(*counters));
+    if (counters == NULL)
+    {
+        return -ENOMEM;
+    }
+    /*
+     * New transitions may appear between sizing and merging; dump only those
+     * that fit.
+     */
+    int merged = infinite_state_counter_merge(counters, size);
+    if (merged > size)
+    {
+        merged = size;
+    }
+    int err = 0;
+    for (int counter = 0; counter < merged && err == 0; counter++)
+    {
+        const void *from = counters[counter].from, *to = counters[counter].to;
+        if ((name != NULL ? fprintf(file, "%s %s %lu\n", from ? name(from) : "-", to ? name(to) : "-",
+                                    counters[counter].count)
+                          : fprintf(file, "%p %p %lu\n", from, to, counters[counter].count)) < 0)
+        {
+            err = -EIO;
+        }
+    }
+    free(counters);
+    return err < 0 ? err : merged;
+}
+
+void infinite_state_counter_reset(void)
+{
+    for (struct shard *shard = atomic_load_explicit(&shards, memory_order_acquire); shard != NULL;
+         shard = shard->next)
+    {
+        for (int index = 0; index < INFINITE_STATE_COUNTER_PAIRS; index++)
+        {
+            atomic_store_explicit(&shard->pairs[index].used, 0, memory_order_relaxed);
+        }
+    }
+    atomic_store_explicit(&dropped, 0, memory_order_relaxed);
+}
+
+unsigned long infinite_state_counter_dropped(void)
+{
+    return atomic_load_explicit(&dropped, memory_order_relaxed);
+}
@@ -0,0 +1,153 @@
+/*
+ * SPDX-FileCopyrightText: 2023, Roy Ratcliffe, Northumberland, United Kingdom
+ * SPDX-License-Identifier: MIT
+ */
+/*!
+ * \file infinite_state_coverage.c
+ * \brief Coverage bitmap implementation.
+ *
+ * The state bitmap holds an entry bit and an exit bit side by side for each
+ * state's hash. The transition bitmap combines the two states' hashes
+ * asymmetrically, so that a transition and its reverse differ.
+ */
+
+#include "infinite_state_coverage.h"
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#if INFINITE_STATE_COVERAGE_BITS & (INFINITE_STATE_COVERAGE_BITS - 1)
+#error "INFINITE_STATE_COVERAGE_BITS must be a power of two"
+#endif
+
+static atomic_uchar state_bits[INFINITE_STATE_COVERAGE_BITS / 8];
+
+static atomic_uchar transition_bits[INFINITE_STATE_COVERAGE_BITS / 8];
+
+/*
+ * The SplitMix64 finaliser mixes every address bit into every hash bit. States
+ * laid out at a regular stride within one topology object would otherwise
+ * hash to related bits, and their transitions collide far more often than
+ * chance.
+ */
+static size_t infinite_state_coverage_hash(const void *state)
+{
+    uint64_t hash = (uint64_t)(uintptr_t)state;
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9U;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebU;
+    return (size_t)(hash ^ (hash >> 31));
+}
+
+static void infinite_state_coverage_set(atomic_uchar *map, size_t bit)
+{
+    bit &= INFINITE_STATE_COVERAGE_BITS - 1;
+    unsigned char mask = (unsigned char)(1U << (bit & 7));
+    atomic_uchar *byte = map + bit / 8;
+    /*
+     * Covered bits cost only the load; the read-modify-write runs once per
+     * bit.
+     */
+    if (!(atomic_load_explicit(byte, memory_order_relaxed) & mask))
+    {
+        atomic_fetch_or_explicit(byte, mask, memory_order_relaxed);
+    }
+}
+
+static int infinite_state_coverage_get(atomic_uchar *map, size_t bit)
+{
+    bit &= INFINITE_STATE_COVERAGE_BITS - 1;
+    return (atomic_load_explicit(map + bit / 8, memory_order_relaxed) >> (bit & 7)) & 1;
+}
+
+static size_t infinite_state_coverage_edge(const void *from, const void *to)
+{
+    return infinite_state_coverage_hash(from) ^ (infinite_state_coverage_hash(to) >> 1);
+}
+
+void infinite_state_coverage_enter(const void *state)
+{
+    infinite_state_coverage_set(state_bits, infinite_state_coverage_hash(state) << 1);
+}
+
+void infinite_state_coverage_exit(const void *state)
+{
+    infinite_state_coverage_set(state_bits, infinite_state_coverage_hash(state) << 1 | 1);
+}
+
+void infinite_state_coverage_transition(const void *from, const void *to)
+{
+    infinite_state_coverage_set(transition_bits, infinite_state_coverage_edge(from, to));
+}
+
+int infinite_state_coverage_entered(const void *state)
+{
+    return infinite_state_coverage_get(state_bits, infinite_state_coverage_hash(state) << 1);
+}
+
+int infinite_state_coverage_exited(const void *state)
+{
+    return infinite_state_coverage_get(state_bits, infinite_state_coverage_hash(state) << 1 | 1);
+}
+
+int infinite_state_coverage_transitioned(const void *from, const void *to)
+{
+    return infinite_state_coverage_get(transition_bits, infinite_state_coverage_edge(from, to));
+}
+
+size_t infinite_state_coverage_bits(void)
+{
+    size_t bits = 0;
+    for (size_t index = 0; index < INFINITE_STATE_COVERAGE_BITS / 8; index++)
+    {
+        unsigned bytes = atomic_load_explicit(state_bits + index, memory_order_relaxed) |
+                        (unsigned)atomic_load_explicit(transition_bits + index, memory_order_relaxed) << 8;
+        for (; bytes != 0; bytes &= bytes - 1)
+        {
+            bits++;
+        }
+    }
+    return bits;
+}
+
+int infinite_state_coverage_dump(FILE *file, const void *const states[], int count,
+                                 const char *(*name)(const void *state))
+{
+    int dumped = 0;
+    for (int index = 0; index < count; index++)
+    {
+        const void *state = states[index];
+        if ((name != NULL ? fprintf(file, "%s", name(state)) : fprintf(file, "%p", state)) < 0 ||
+            fprintf(file, "%s%s\n", infinite_state_coverage_entered(state) ? " entered" : "",
+                    infinite_state_coverage_exited(state) ? " exited" : "") < 0)
+        {
+            return -EIO;
+        }
+    }
+    for (int from = 0; from < count; from++)
+    {
+        for (int to = 0; to < count; to++)
+        {
+            if (!infinite_state_coverage_transitioned(states[from], states[to]))
+            {
+                continue;
+            }
+            if ((name != NULL ? fprintf(file, "%s %s\n", name(states[from]), name(states[to]))
+                              : fprintf(file, "%p %p\n", states[from], states[to])) < 0)
+            {
+                return -EIO;
+            }
+            dumped++;
+        }
+    }
+    return dumped;
+}
+
+void infinite_state_coverage_reset(void)
+{
+    for (size_t index = 0; index < INFINITE_STATE_COVERAGE_BITS / 8; index++)
+    {
+        atomic_store_explicit(state_bits + index, 0, memory_order_relaxed);
+        atomic_store_explicit(transition_bits + index, 0, memory_order_relaxed);
+    }
+}
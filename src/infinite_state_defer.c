@@ -0,0 +1,100 @@
+/*
+ * SPDX-FileCopyrightText: 2023, Roy Ratcliffe, Northumberland, United Kingdom
+ * SPDX-License-Identifier: MIT
+ */
+/*!
+ * \file infinite_state_defer.c
+ * \brief Deferred-event implementation.
+ *
+ * Queues link events through their embedded next pointers and track the last
+ * link, so that posting appends and recalling splices a whole list without
+ * walking it.
+ */
+
+#include "infinite_state_defer.h"
+
+#include <errno.h>
+
+void infinite_state_queue_init(struct infinite_state_queue *queue)
+{
+    queue->head = NULL;
+    queue->tail = &queue->head;
+}
+
+void infinite_state_queue_post(struct infinite_state_queue *queue, struct infinite_state_event *event)
+{
+    event->next = NULL;
+    *queue->tail = event;
+    queue->tail = &event->next;
+}
+
+struct infinite_state_event *infinite_state_queue_take(struct infinite_state_queue *queue)
+{
+    struct infinite_state_event *event = queue->head;
+    if (event != NULL && (queue->head = event->next) == NULL)
+    {
+        queue->tail = &queue->head;
+    }
+    return event;
+}
+
+void infinite_state_deferral_init(struct infinite_state_deferral *deferral, struct infinite_state_queue *queue)
+{
+    deferral->queue = queue;
+    for (int level = 0; level < INFINITE_STATE_MACHINE_MAX_DEPTH; level++)
+    {
+        infinite_state_queue_init(deferral->levels + level);
+    }
+}
+
+void infinite_state_machine_deferral(struct infinite_state_machine *machine,
+                                     struct infinite_state_deferral *deferral)
+{
+    machine->deferral = deferral;
+}
+
+int infinite_state_machine_defer(struct infinite_state_machine *machine, const struct infinite_state *state,
+                                 struct infinite_state_event *event)
+{
+    if (machine->deferral == NULL || state == NULL)
+    {
+        return -EINVAL;
+    }
+    infinite_state_ref ref = INFINITE_STATE_REF(state);
+    /*
+     * Machines never grow deeper than the deferral's levels, since pushing
+     * refuses; bound the search regardless.
+     */
+    int depth = machine->depth < INFINITE_STATE_MACHINE_MAX_DEPTH ? machine->depth : INFINITE_STATE_MACHINE_MAX_DEPTH;
+    while (depth > 0 && machine->states[depth - 1] != ref)
+    {
+        depth--;
+    }
+    if (depth == 0)
+    {
+        return -EINVAL;
+    }
+    infinite_state_queue_post(machine->deferral->levels + depth - 1, event);
+    return 0;
+}
+
+void infinite_state_deferral_recall(struct infinite_state_deferral *deferral, int level)
+{
+    if (level < 0 || level >= INFINITE_STATE_MACHINE_MAX_DEPTH)
+    {
+        return;
+    }
+    struct infinite_state_queue *deferred = deferral->levels + level;
+    if (deferred->head == NULL)
+    {
+        return;
+    }
+    struct infinite_state_queue *queue = deferral->queue;
+    *deferred->tail = queue->head;
+    if (queue->head == NULL)
+    {
+        queue->tail = deferred->tail;
+    }
+    queue->head = deferred->head;
+    infinite_state_queue_init(deferred);
+}
@@ -0,0 +1,454 @@
+/*
+ * SPDX-FileCopyrightText: 2023, Roy Ratcliffe, Northumberland, United Kingdom
+ * SPDX-License-Identifier: MIT
+ */
+/*!
+ * \file infinite_state_explorer.c
+ * \brief Parallel breadth-first exploration of reachable configurations.
+ *
+ * Threads expand each level's frontier in chunks claimed atomically, and meet
+ * at a barrier between levels. Configurations live in one lock-free hash set
+ * sized up front: open addressing with linear probing, where claiming an empty
+ * slot's tag by compare-and-swap grants the right to write its key, and
+ * publishing the tag with release semantics makes the key visible. Inserting a
+ * new configuration appends its slot to the next level's frontier.
+ *
+ * Each transition's target path, as identifiers, is precomputed; so is an
+ * index of transitions by source. Expanding a configuration therefore never
+ * walks the topology.
+ */
+
+#include "infinite_state_explorer.h"
+#include "infinite_state_machine.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * Slot tags: empty, claimed while writing its key, else a published key's
+ * hash bits with bit 1 set.
+ */
+#define EMPTY 0U
+#define BUSY 1U
+
+/*
+ * Frontier entries claimed at a time.
+ */
+#define CHUNK 64
+
+struct index
+{
+    const struct infinite_state *state;
+    infinite_state_explorer_id id;
+};
+
+struct explorer
+{
+    const struct infinite_state_explorer *model;
+    int width;
+
+    /*
+     * Target paths by transition, depth wide; transitions by source
+     * identifier, in compressed sparse rows.
+     */
+    infinite_state_explorer_id *paths;
+    int *sources;
+    int *rows;
+
+    /*
+     * The hash set of configurations.
+     */
+    _Atomic uint32_t *tags;
+    infinite_state_explorer_id *keys;
+    size_t mask;
+    atomic_size_t configurations;
+    atomic_int overflow;
+
+    /*
+     * The current and next frontiers.
+     */
+    size_t *frontier;
+    size_t frontiered;
+    size_t *next;
+    atomic_size_t nexted;
+    atomic_size_t claimed;
+    atomic_size_t transitions;
+    int done;
+    pthread_mutex_t gate;
+    pthread_barrier_t barrier;
+};
+
+static int infinite_state_explorer_compare(const void *left, const void *right)
+{
+    const struct infinite_state *l = ((const struct index *)left)->state;
+    const struct infinite_state *r = ((const struct index *)right)->state;
+    return l < r ? -1 : l > r;
+}
+
+static infinite_state_explorer_id infinite_state_explorer_find(const struct index *index, int count,
+                                                               const struct infinite_state *state)
+{
+    struct index key = {.state = state};
+    const struct index *found = bsearch(&key, index, count, sizeof(*index), infinite_state_explorer_compare);
+    return found == NULL ? 0 : found->id;
+}
+
+/*
+ * Writes a state's path from the root as identifiers, zero padded to the
+ * depth; a NULL state gives an empty path. The path extends through initial
+ * sub-states. Completing follows completion transitions too, at most once per
+ * state in the topology.
+ */
+static int infinite_state_explorer_path(const struct index *index, int count, int depth,
+                                        const struct infinite_state *state, int complete,
+                                        infinite_state_explorer_id *path)
+{
+    const struct infinite_state *topology[INFINITE_STATE_MACHINE_MAX_DEPTH];
+    int length;
+    for (int completed = 0;; completed++)
+    {
+        length = infinite_state_topology(state, depth, topology) - topology;
+        while (length > 0 && length < depth && INFINITE_STATE_DEREF(topology[length - 1]->initial) != NULL)
+        {
+            topology[length] = INFINITE_STATE_DEREF(topology[length - 1]->initial);
+            length++;
+        }
+        if (!complete || length == 0 || completed == count ||
+            INFINITE_STATE_DEREF(topology[length - 1]->completion) == NULL)
+        {
+            break;
+        }
+        state = INFINITE_STATE_DEREF(topology[length - 1]->completion);
+    }
+    for (int level = 0; level < depth; level++)
+    {
+        path[level] = level < length ? infinite_state_explorer_find(index, count, topology[level]) : 0;
+        if (level < length && path[level] == 0)
+        {
+            return -EINVAL;
+        }
+    }
+    return 0;
+}
+
+static uint64_t infinite_state_explorer_hash(const infinite_state_explorer_id *key, int width)
+{
+    uint64_t hash = 0xcbf29ce484222325U;
+    for (int index = 0; index < width; index++)
+    {
+        hash = (hash ^ key[index]) * 0x100000001b3U;
+    }
+    return hash ^ (hash >> 29);
+}
+
+/*
+ * Inserts a configuration. Answers 1 and its slot if new, 0 if already
+ * present or beyond capacity.
+ */
+static int infinite_state_explorer_insert(struct explorer *explorer, const infinite_state_explorer_id *key,
+                                          size_t *slot)
+{
+    int width = explorer->width;
+    uint64_t hash = infinite_state_explorer_hash(key, width);
+    uint32_t tag = (uint32_t)(hash >> 32) | 2U;
+    for (size_t probe = hash & explorer->mask;; probe = (probe + 1) & explorer->mask)
+    {
+        _Atomic uint32_t *at = explorer->tags + probe;
+        uint32_t seen = atomic_load_explicit(at, memory_order_acquire);
+        if (seen == EMPTY)
+        {
+            if (atomic_compare_exchange_strong_explicit(at, &seen, BUSY, memory_order_acquire,
+                                                        memory_order_acquire))
+            {
+                memcpy(explorer->keys + probe * width, key, width * sizeof(*key));
+                atomic_store_explicit(at, tag, memory_order_release);
+                if (atomic_fetch_add_explicit(&explorer->configurations, 1, memory_order_relaxed) >=
+                    explorer->model->capacity)
+                {
+                    atomic_store_explicit(&explorer->overflow, 1, memory_order_relaxed);
+                    return 0;
+                }
+                *slot = probe;
+                return 1;
+            }
+        }
+        while (seen == BUSY)
+        {
+            seen = atomic_load_explicit(at, memory_order_acquire);
+        }
+        if (seen == tag && memcmp(explorer->keys + probe * width, key, width * sizeof(*key)) == 0)
+        {
+            return 0;
+        }
+    }
+}
+
+static void infinite_state_explorer_expand(struct explorer *explorer, size_t slot,
+                                           infinite_state_explorer_id *successor, size_t *transitions)
+{
+    const struct infinite_state_explorer *model = explorer->model;
+    int width = explorer->width;
+    int depth = model->depth;
+    const infinite_state_explorer_id *key = explorer->keys + slot * width;
+    for (int region = 0; region < model->regions; region++)
+    {
+        for (int level = 0; level < depth && key[region * depth + level] != 0; level++)
+        {
+            infinite_state_explorer_id id = key[region * depth + level];
+            for (int row = explorer->rows[id - 1]; row < explorer->rows[id]; row++)
+            {
+                int transition = explorer->sources[row];
+                if (model->transitions[transition].region != region)
+                {
+                    continue;
+                }
+                ++*transitions;
+                memcpy(successor, key, width * sizeof(*key));
+                memcpy(successor + region * depth, explorer->paths + transition * depth, depth * sizeof(*key));
+                size_t inserted;
+                if (infinite_state_explorer_insert(explorer, successor, &inserted))
+                {
+                    explorer->next[atomic_fetch_add_explicit(&explorer->nexted, 1, memory_order_relaxed)] = inserted;
+                }
+                if (atomic_load_explicit(&explorer->overflow, memory_order_relaxed))
+                {
+                    return;
+                }
+            }
+        }
+    }
+}
+
+static void *infinite_state_explorer_work(void *arg)
+{
+    struct explorer *explorer = arg;
+    pthread_mutex_lock(&explorer->gate);
+    pthread_mutex_unlock(&explorer->gate);
+    infinite_state_explorer_id *successor = malloc(explorer->width * sizeof(*successor));
+    size_t transitions = 0;
+    for (;;)
+    {
+        size_t claim;
+        while (successor != NULL && !atomic_load_explicit(&explorer->overflow, memory_order_relaxed) &&
+               (claim = atomic_fetch_add_explicit(&explorer->claimed, CHUNK, memory_order_relaxed)) <
+                   explorer->frontiered)
+        {
+            size_t end = claim + CHUNK < explorer->frontiered ? claim + CHUNK : explorer->frontiered;
+            for (; claim < end; claim++)
+            {
+                infinite_state_explorer_expand(explorer, explorer->frontier[claim], successor, &transitions);
+            }
+        }
+        if (successor == NULL)
+        {
+            atomic_store_explicit(&explorer->overflow, -1, memory_order_relaxed);
+        }
+        if (pthread_barrier_wait(&explorer->barrier) == PTHREAD_BARRIER_SERIAL_THREAD)
+        {
+            /*
+             * The next frontier becomes current.
+             */
+            size_t *frontier = explorer->frontier;
+            explorer->frontier = explorer->next;
+            explorer->next = frontier;
+            explorer->frontiered = atomic_load_explicit(&explorer->nexted, memory_order_relaxed);
+            atomic_store_explicit(&explorer->nexted, 0, memory_order_relaxed);
+            atomic_store_explicit(&explorer->claimed, 0, memory_order_relaxed);
+            explorer->done =
+                explorer->frontiered == 0 || atomic_load_explicit(&explorer->overflow, memory_order_relaxed);
+        }
+        pthread_barrier_wait(&explorer->barrier);
+        if (explorer->done)
+        {
+            break;
+        }
+    }
+    atomic_fetch_add_explicit(&explorer->transitions, transitions, memory_order_relaxed);
+    free(successor);
+    return NULL;
+}
+
+/*
+ * Precomputes the target paths and the transitions by source.
+ */
+static int infinite_state_explorer_prepare(struct explorer *explorer, const struct index *index,
+                                           infinite_state_explorer_id *initial)
+{
+    const struct infinite_state_explorer *model = explorer->model;
+    int depth = model->depth;
+    for (int region = 0; region < model->regions; region++)
+    {
+        if (infinite_state_explorer_path(index, model->count, depth, model->initial[region], 0,
+                                         initial + region * depth) < 0)
+        {
+            return -EINVAL;
+        }
+    }
+    for (int transition = 0; transition < model->transitioned; transition++)
+    {
+        const struct infinite_state_explorer_transition *at = model->transitions + transition;
+        infinite_state_explorer_id source = infinite_state_explorer_find(index, model->count, at->source);
+        if (source == 0 || at->region < 0 || at->region >= model->regions ||
+            infinite_state_explorer_path(index, model->count, depth, at->target, 1,
+                                         explorer->paths + transition * depth) < 0)
+        {
+            return -EINVAL;
+        }
+        explorer->rows[source - 1]++;
+    }
+    /*
+     * Sum the counts to give each source's end row, then fill backwards so
+     * that each ends at its start row. Source s has rows s - 1 up to s.
+     */
+    for (int id = 1; id < model->count; id++)
+    {
+        explorer->rows[id] += explorer->rows[id - 1];
+    }
+    explorer->rows[model->count] = model->transitioned;
+    for (int transition = model->transitioned - 1; transition >= 0; transition--)
+    {
+        infinite_state_explorer_id source =
+            infinite_state_explorer_find(index, model->count, model->transitions[transition].source);
+        explorer->sources[--explorer->rows[source - 1]] = transition;
+    }
+    return 0;
+}
+
+int infinite_state_explore(const struct infinite_state_explorer *model,
+                           struct infinite_state_exploration *exploration)
+{
+    if (model->depth < 1 || model->depth > INFINITE_STATE_MACHINE_MAX_DEPTH || model->regions < 1 ||
+        model->capacity < 1)
+    {
+        return -EINVAL;
+    }
+    struct explorer explorer = {
+        .model = model,
+        .width = model->regions * model->depth,
+        .gate = PTHREAD_MUTEX_INITIALIZER,
+    };
+    int threads = model->threads > 0 ? model->threads : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads < 1)
+    {
+        threads = 1;
+    }
+    /*
+     * Each thread inserts at most one configuration beyond capacity before
+     * noticing the overflow; the set never fills.
+     */
+    size_t slots = 1;
+    while (slots < 2 * model->capacity + threads)
+    {
+        slots <<= 1;
+    }
+    explorer.mask = slots - 1;
+    struct index *index = malloc(model->count * sizeof(*index));
+    infinite_state_explorer_id *initial = malloc(explorer.width * sizeof(*initial));
+    explorer.paths = malloc(((size_t)model->transitioned * model->depth + 1) * sizeof(*explorer.paths));
+    explorer.sources = malloc(((size_t)model->transitioned + 1) * sizeof(*explorer.sources));
+    explorer.rows = calloc(model->count + 1, sizeof(*explorer.rows));
+    explorer.tags = calloc(slots, sizeof(*explorer.tags));
+    explorer.keys = malloc(slots * explorer.width * sizeof(*explorer.keys));
+    explorer.frontier = malloc(model->capacity * sizeof(*explorer.frontier));
+    explorer.next = malloc(model->capacity * sizeof(*explorer.next));
+    pthread_t *workers = malloc(threads * sizeof(*workers));
+    int err = 0;
+    if (index == NULL || initial == NULL || explorer.paths == NULL || explorer.sources == NULL ||
+        explorer.rows == NULL || explorer.tags == NULL || explorer.keys == NULL || explorer.frontier == NULL ||
+        explorer.next == NULL || workers == NULL)
+    {
+        err = -ENOMEM;
+        goto out;
+    }
+    for (int id = 0; id < model->count; id++)
+    {
+        index[id].state = model->states[id];
+        index[id].id = id + 1;
+    }
+    qsort(index, model->count, sizeof(*index), infinite_state_explorer_compare);
+    if ((err = infinite_state_explorer_prepare(&explorer, index, initial)) < 0)
+    {
+        goto out;
+    }
+    infinite_state_explorer_insert(&explorer, initial, explorer.frontier);
+    explorer.frontiered = 1;
+    /*
+     * Workers wait at the gate until the barrier knows how many started.
+     */
+    pthread_mutex_lock(&explorer.gate);
+    int started = 1;
+    while (started < threads &&
+           pthread_create(workers + started, NULL, infinite_state_explorer_work, &explorer) == 0)
+    {
+        started++;
+    }
+    pthread_barrier_init(&explorer.barrier, NULL, started);
+    pthread_mutex_unlock(&explorer.gate);
+    infinite_state_explorer_work(&explorer);
+    for (int worker = 1; worker < started; worker++)
+    {
+        pthread_join(workers[worker], NULL);
+    }
+    pthread_barrier_destroy(&explorer.barrier);
+    int overflow = atomic_load_explicit(&explorer.overflow, memory_order_relaxed);
+    if (overflow != 0)
+    {
+        err = overflow > 0 ? -ENOSPC : -ENOMEM;
+        goto out;
+    }
+    /*
+     * Compact the configurations and mark the states they activate.
+     */
+    size_t configurations = atomic_load_explicit(&explorer.configurations, memory_order_relaxed);
+    exploration->configurations = configurations;
+    exploration->transitions = atomic_load_explicit(&explorer.transitions, memory_order_relaxed);
+    exploration->ids = malloc(configurations * explorer.width * sizeof(*exploration->ids));
+    exploration->reached = calloc(model->count, sizeof(*exploration->reached));
+    if (exploration->ids == NULL || exploration->reached == NULL)
+    {
+        infinite_state_exploration_free(exploration);
+        err = -ENOMEM;
+        goto out;
+    }
+    infinite_state_explorer_id *ids = exploration->ids;
+    for (size_t slot = 0; slot < slots; slot++)
+    {
+        if (atomic_load_explicit(explorer.tags + slot, memory_order_relaxed) == EMPTY)
+        {
+            continue;
+        }
+        memcpy(ids, explorer.keys + slot * explorer.width, explorer.width * sizeof(*ids));
+        for (int at = 0; at < explorer.width; at++)
+        {
+            if (ids[at] != 0)
+            {
+                exploration->reached[ids[at] - 1] = 1;
+            }
+        }
+        ids += explorer.width;
+    }
+out:
+    free(workers);
+    free(explorer.next);
+    free(explorer.frontier);
+    free(explorer.keys);
+    free((void *)explorer.tags);
+    free(explorer.rows);
+    free(explorer.sources);
+    free(explorer.paths);
+    free(initial);
+    free(index);
+    return err;
+}
+
+void infinite_state_exploration_free(struct infinite_state_exploration *exploration)
+{
+    free(exploration->ids);
+    free(exploration->reached);
+    exploration->ids = NULL;
+    exploration->reached = NULL;
+}
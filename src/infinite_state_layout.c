@@ -0,0 +1,172 @@
+/*
+ * SPDX-FileCopyrightText: 2023, Roy Ratcliffe, Northumberland, United Kingdom
+ * SPDX-License-Identifier: MIT
+ */
+/*!
+ * \file infinite_state_layout.c
+ * \brief Frequency-driven topology layout implementation.
+ *
+ * Layout is an offline or start-up operation. It allocates working storage,
+ * then sorts the states by address so that finding each state, for every
+ * counter and every link, costs a binary search.
+ */
+
+#include "infinite_state_layout.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * A state and its index within the states given, sortable by either address
+ * or heat.
+ */
+struct index
+{
+    const struct infinite_state *state;
+    unsigned long heat;
+    int index;
+};
+
+static int infinite_state_layout_compare(const void *left, const void *right)
+{
+    const struct infinite_state *l = ((const struct index *)left)->state;
+    const struct infinite_state *r = ((const struct index *)right)->state;
+    return l < r ? -1 : l > r;
+}
+
+/*
+ * Orders hottest first, keeping the given order between equal heats.
+ */
+static int infinite_state_layout_hotter(const void *left, const void *right)
+{
+    const struct index *l = left;
+    const struct index *r = right;
+    if (l->heat != r->heat)
+    {
+        return l->heat > r->heat ? -1 : 1;
+    }
+    return l->index < r->index ? -1 : l->index > r->index;
+}
+
+/*
+ * Finds a state's index, or -1 if not laid out.
+ */
+static int infinite_state_layout_find(const struct index *index, int count, const struct infinite_state *state)
+{
+    struct index key = {.state = state};
+    const struct index *found = bsearch(&key, index, count, sizeof(*index), infinite_state_layout_compare);
+    return found == NULL ? -1 : found->index;
+}
+
+/*
+ * Places a state after its unplaced super-states, root first. Marks the
+ * unplaced states going up, then numbers them coming down the same chain. A
+ * cyclic topology thereby terminates; the chain stops at the first marked
+ * state.
+ */
+static void infinite_state_layout_place(const struct infinite_state *const states[], const struct index *index,
+                                        int count, int sub, int *slots, int *placed)
+{
+    int chain = 0;
+    for (int at = sub; at >= 0 && slots[at] < 0; chain++)
+    {
+        slots[at] = count;
+        at = infinite_state_layout_find(index, count, INFINITE_STATE_DEREF(states[at]->super));
+    }
+    for (int at = sub, link = chain; link > 0; link--)
+    {
+        slots[at] = *placed + link - 1;
+        at = infinite_state_layout_find(index, count, INFINITE_STATE_DEREF(states[at]->super));
+    }
+    *placed += chain;
+}
+
+/*
+ * Rewrites a link to a laid-out state to point at its copy.
+ */
+static void infinite_state_layout_link(const struct index *index, int count, const struct infinite_state *relocated[],
+                                       infinite_state_ref *link)
+{
+    int found = infinite_state_layout_find(index, count, INFINITE_STATE_DEREF(*link));
+    if (found >= 0)
+    {
+        *link = INFINITE_STATE_REF(relocated[found]);
+    }
+}
+
+int infinite_state_layout(const struct infinite_state *const states[], int count, size_t size,
+                          const struct infinite_state_counter counters[], int counted, void *arena,
+                          const struct infinite_state *relocated[])
+{
+    if (count < 0 || size < sizeof(struct infinite_state) || (count > 0 && arena == NULL))
+    {
+        return -EINVAL;
+    }
+    struct index *index = malloc((count > 0 ? count : 1) * sizeof(*index));
+    struct index *orders = malloc((count > 0 ? count : 1) * sizeof(*orders));
+    unsigned long *heats = calloc(count > 0 ? count : 1, sizeof(*heats));
+    int *slots = malloc((count > 0 ? count : 1) * sizeof(*slots));
+    if (index == NULL || orders == NULL || heats == NULL || slots == NULL)
+    {
+        free(index);
+        free(orders);
+        free(heats);
+        free(slots);
+        return -ENOMEM;
+    }
+    for (int at = 0; at < count; at++)
+    {
+        index[at] = (struct index){.state = states[at], .index = at};
+        slots[at] = -1;
+    }
+    qsort(index, count, sizeof(*index), infinite_state_layout_compare);
+    for (int counter = 0; counter < counted; counter++)
+    {
+        int from = infinite_state_layout_find(index, count, counters[counter].from);
+        int to = infinite_state_layout_find(index, count, counters[counter].to);
+        if (from >= 0)
+        {
+            heats[from] += counters[counter].count;
+        }
+        if (to >= 0 && to != from)
+        {
+            heats[to] += counters[counter].count;
+        }
+    }
+    /*
+     * Order the states hottest first, then place them. The address order is
+     * still needed while placing, so rank a copy.
+     */
+    for (int at = 0; at < count; at++)
+    {
+        orders[at] = (struct index){.state = states[at], .heat = heats[at], .index = at};
+    }
+    qsort(orders, count, sizeof(*orders), infinite_state_layout_hotter);
+    int placed = 0;
+    for (int order = 0; order < count; order++)
+    {
+        infinite_state_layout_place(states, index, count, orders[order].index, slots, &placed);
+    }
+    /*
+     * Copy the nodes into their slots, then rewrite their links.
+     */
+    unsigned char *nodes = arena;
+    for (int at = 0; at < count; at++)
+    {
+        relocated[at] = (const struct infinite_state *)(nodes + slots[at] * size);
+        (void)memcpy(nodes + slots[at] * size, states[at], size);
+    }
+    for (int at = 0; at < count; at++)
+    {
+        struct infinite_state *node = (struct infinite_state *)(nodes + slots[at] * size);
+        infinite_state_layout_link(index, count, relocated, &node->super);
+        infinite_state_layout_link(index, count, relocated, &node->initial);
+        infinite_state_layout_link(index, count, relocated, &node->completion);
+    }
+    free(index);
+    free(heats);
+    free(orders);
+    free(slots);
+    return 0;
+}
@@ -8,19 +8,36 @@
  *
  * Provides push and pop (enter and exit) semantics plus goto that performs
  * least–common–ancestor optimisation: only differing tail states are
- * exited or entered.
+ * exited or entered. Transitions by kind exit and enter less still when the
+ * target lies within an active source state.
  *
  * Invariants:
- * - states[0..depth-1] are valid pointers, states[depth..] are \c NULL (after init or pop).
- * - depth <= INFINITE_STATE_MACHINE_MAX_DEPTH.
+ * - states[0..depth-1] are valid pointers, states[depth..] are \c NULL (after init or exit).
+ * - depth <= max_depth <= INFINITE_STATE_MACHINE_MAX_DEPTH.
+ * - arena->used equals the aligned local storage sizes of states[0..depth-1] summed,
+ *   plus the exiting state's while its exit actions run.
  *
  * Notes:
  * - Callbacks (enter and exit) are invoked after structural mutation so they observe the new stack.
  * - Callbacks must NOT directly corrupt depth or states; they may trigger further transitions
- *   only if higher-level code is designed for reentrancy.
+ *   only if higher-level code is designed for reentrancy. Real-time machines turn such
+ *   transitions into requests of the committing transaction instead.
  */
 
 #include "infinite_state_machine.h"
+#include "infinite_state_probe.h"
+#ifdef INFINITE_STATE_PROFILE
+#include "infinite_state_profile.h"
+#endif
+#ifdef INFINITE_STATE_COUNTER
+#include "infinite_state_counter.h"
+#endif
+#ifdef INFINITE_STATE_COVERAGE
+#include "infinite_state_coverage.h"
+#endif
+#ifdef INFINITE_STATE_DEFER
+#include "infinite_state_defer.h"
+#endif
 
 #include <string.h>
 #include <errno.h>
@@ -32,7 +49,7 @@
  * \param state The state to enter.
  * \return 0 on success, or a negative error code on failure.
  */
-static int infinite_state_machine_enter(struct infinite_state_machine *machine, struct infinite_state *state);
+static int infinite_state_machine_enter(struct infinite_state_machine *machine, const struct infinite_state *state);
 
 /*!
  * \brief Exits a state in the infinite state machine.
@@ -48,59 +65,351 @@ static int infinite_state_machine_exit(struct infinite_state_machine *machine);
  * \param state The state to push.
  * \return 0 on success, or a negative error code on failure.
  */
-static int infinite_state_machine_push(struct infinite_state_machine *machine, struct infinite_state *state);
+static int infinite_state_machine_push(struct infinite_state_machine *machine, const struct infinite_state *state);
 
 /*!
  * \brief Pops the top state from the infinite state machine.
+ * Leaves the popped state's slot and local storage for exiting to release.
  * \param machine The infinite state machine to pop from.
  * \return The popped state, or \c NULL if the machine is empty.
  */
-static struct infinite_state *infinite_state_machine_pop(struct infinite_state_machine *machine);
+static const struct infinite_state *infinite_state_machine_pop(struct infinite_state_machine *machine);
 
-void infinite_state_machine_init(struct infinite_state_machine *machine)
+/*!
+ * \brief Extends a forward topology by the initial sub-states of its innermost
+ * state.
+ * \param topology The forward topology, with storage for the maximum depth.
+ * \param depth The depth of the topology.
+ * \param max_depth The maximum depth.
+ * \return The extended depth, at most the maximum depth.
+ */
+static int infinite_state_machine_initial(const struct infinite_state *topology[], int depth, int max_depth);
+
+/*!
+ * \brief Computes the forward topology of going to a state, through its
+ * initial sub-states.
+ * \param state The state, or \c NULL.
+ * \param max_depth The maximum depth, at most
+ * \c{INFINITE_STATE_MACHINE_MAX_DEPTH}.
+ * \param topology The forward topology, with storage for the maximum depth.
+ * \return The depth of the topology, or \c -ENOMEM if it exceeds the maximum
+ * depth.
+ */
+static int infinite_state_machine_forward(const struct infinite_state *state, int max_depth,
+                                          const struct infinite_state *topology[]);
+
+INFINITE_STATE_API void infinite_state_machine_init(struct infinite_state_machine *machine)
 {
     machine->depth = 0;
-    (void)memset(machine->states, 0, sizeof(machine->states));
+    (void)memset(machine->states, 0, machine->max_depth * sizeof(*machine->states));
+    machine->arena = NULL;
+#ifdef INFINITE_STATE_ACTIVATIONS
+    machine->activations = NULL;
+#endif
+#ifdef INFINITE_STATE_DEFER
+    machine->deferral = NULL;
+#endif
+#ifdef INFINITE_STATE_REALTIME
+    machine->transaction = NULL;
+#endif
+}
+
+INFINITE_STATE_API int infinite_state_machine_init_depth(struct infinite_state_machine *machine, int max_depth)
+{
+    if (max_depth < 1 || max_depth > INFINITE_STATE_MACHINE_MAX_DEPTH)
+    {
+        return -EINVAL;
+    }
+    machine->max_depth = max_depth;
+    infinite_state_machine_init(machine);
+    return 0;
 }
 
-void infinite_state_machine_goto(struct infinite_state_machine *machine, struct infinite_state *state)
+INFINITE_STATE_API void infinite_state_machine_arena(struct infinite_state_machine *machine, struct infinite_state_arena *arena)
 {
-    if (state == infinite_state_machine_top(machine))
+    machine->arena = arena;
+    if (arena != NULL)
     {
-        return;
+        arena->used = 0;
     }
-    struct infinite_state_machine jump;
-    infinite_state_machine_jump(&jump, state);
-    int depth = 0;
-    while (depth < machine->depth && depth < jump.depth && machine->states[depth] == jump.states[depth])
+}
+
+#ifdef INFINITE_STATE_ACTIVATIONS
+INFINITE_STATE_API void infinite_state_machine_activations(struct infinite_state_machine *machine, unsigned long *activations)
+{
+    machine->activations = activations;
+}
+
+INFINITE_STATE_API unsigned long infinite_state_machine_activation(const struct infinite_state_machine *machine,
+                                                                  const struct infinite_state *state)
+{
+    if (state == NULL || machine->activations == NULL)
     {
-        depth++;
+        return 0;
     }
-    while (machine->depth > depth)
+    infinite_state_ref ref = INFINITE_STATE_REF(state);
+    for (int depth = 0; depth < machine->depth; depth++)
+    {
+        if (machine->states[depth] == ref)
+        {
+            return machine->activations[depth];
+        }
+    }
+    return 0;
+}
+#endif
+
+INFINITE_STATE_API void *infinite_state_machine_data(const struct infinite_state_machine *machine, const struct infinite_state *state)
+{
+    if (machine->arena == NULL || state->size == 0)
+    {
+        return NULL;
+    }
+    infinite_state_ref ref = INFINITE_STATE_REF(state);
+    size_t offset = 0;
+    for (int depth = 0; depth < machine->depth; depth++)
+    {
+        if (machine->states[depth] == ref)
+        {
+            return machine->arena->base + offset;
+        }
+        offset += INFINITE_STATE_ALIGN(INFINITE_STATE_DEREF(machine->states[depth])->size);
+    }
+    /*
+     * A state exiting keeps its storage, just above the active states', until
+     * its exit actions return.
+     */
+    if (machine->depth < machine->max_depth && machine->states[machine->depth] == ref &&
+        machine->arena->used > offset)
+    {
+        return machine->arena->base + offset;
+    }
+    return NULL;
+}
+
+INFINITE_STATE_API int infinite_state_machine_goto(struct infinite_state_machine *machine, const struct infinite_state *state)
+{
+#ifdef INFINITE_STATE_REALTIME
+    /*
+     * Actions cannot reenter. Going to a state from within a transition
+     * becomes the committing transaction's next request.
+     */
+    if (machine->transaction != NULL)
+    {
+        infinite_state_machine_transaction_goto(machine->transaction, state);
+        return 0;
+    }
+#endif
+    struct infinite_state_machine_transaction transaction;
+    infinite_state_machine_transaction_begin(&transaction, machine);
+    infinite_state_machine_transaction_goto(&transaction, state);
+    return infinite_state_machine_transaction_commit(&transaction);
+}
+
+INFINITE_STATE_API int infinite_state_machine_transition(struct infinite_state_machine *machine,
+                                                         const struct infinite_state *source,
+                                                         const struct infinite_state *target,
+                                                         enum infinite_state_transition_kind kind)
+{
+    if (machine == NULL || source == NULL)
+    {
+        return -EINVAL;
+    }
+    /*
+     * Find the innermost active instance of the source.
+     */
+    infinite_state_ref ref = INFINITE_STATE_REF(source);
+    int depth = machine->depth;
+    while (depth > 0 && machine->states[depth - 1] != ref)
+    {
+        depth--;
+    }
+    if (depth == 0)
+    {
+        return -EINVAL;
+    }
+    if (kind == INFINITE_STATE_TRANSITION_INTERNAL)
+    {
+        return 0;
+    }
+#ifdef INFINITE_STATE_REALTIME
+    if (machine->transaction != NULL)
+    {
+        return -EBUSY;
+    }
+#endif
+    /*
+     * Walk up from the target, but no further than the source. The states
+     * above the source are already active and stay so.
+     */
+    const struct infinite_state *path[INFINITE_STATE_MACHINE_MAX_DEPTH];
+    int count = 0;
+    const struct infinite_state *state = target;
+    while (state != NULL && state != source && count < INFINITE_STATE_MACHINE_MAX_DEPTH)
+    {
+        path[count++] = state;
+        state = INFINITE_STATE_DEREF(state->super);
+    }
+    if (state != source)
+    {
+        return infinite_state_machine_goto(machine, target);
+    }
+    INFINITE_STATE_PROBE3(goto__start, machine, infinite_state_machine_top(machine), target);
+#ifdef INFINITE_STATE_COUNTER
+    if (target != infinite_state_machine_top(machine))
+    {
+        infinite_state_counter_record(infinite_state_machine_top(machine), target);
+    }
+#endif
+#ifdef INFINITE_STATE_COVERAGE
+    if (target != infinite_state_machine_top(machine))
+    {
+        infinite_state_coverage_transition(infinite_state_machine_top(machine), target);
+    }
+#endif
+#ifdef INFINITE_STATE_PROFILE
+    const struct infinite_state_machine *dispatching = infinite_state_profile_machine;
+    infinite_state_profile_machine = machine;
+#endif
+    /*
+     * Keep the source when local; exit it too when external, then re-enter
+     * it. Entering stops where the machine runs out of depth or storage, or
+     * where an action of a real-time machine requests another transition.
+     */
+    struct infinite_state_machine_transaction transaction;
+    infinite_state_machine_transaction_begin(&transaction, machine);
+#ifdef INFINITE_STATE_REALTIME
+    machine->transaction = &transaction;
+#endif
+    if (kind != INFINITE_STATE_TRANSITION_LOCAL)
+    {
+        depth--;
+    }
+    while (!transaction.pending && machine->depth > depth)
     {
         infinite_state_machine_exit(machine);
     }
-    while (jump.depth > depth)
+    int entered = kind != INFINITE_STATE_TRANSITION_LOCAL || count > 0;
+    int err = kind == INFINITE_STATE_TRANSITION_LOCAL || transaction.pending ? 0
+                                                                              : infinite_state_machine_enter(machine, source);
+    while (!transaction.pending && err == 0 && count > 0)
     {
-        infinite_state_machine_enter(machine, jump.states[depth++]);
+        err = infinite_state_machine_enter(machine, path[--count]);
     }
+    /*
+     * Drill down through the initial sub-states, then complete as going to a
+     * state would.
+     */
+    const struct infinite_state *top = infinite_state_machine_top(machine);
+    while (!transaction.pending && err == 0 && top != NULL && INFINITE_STATE_DEREF(top->initial) != NULL)
+    {
+        err = infinite_state_machine_enter(machine, INFINITE_STATE_DEREF(top->initial));
+        entered = 1;
+        top = infinite_state_machine_top(machine);
+    }
+#ifdef INFINITE_STATE_REALTIME
+    machine->transaction = NULL;
+#endif
+    INFINITE_STATE_PROBE2(goto__done, machine, target);
+    /*
+     * The commit records its own passes: the completion, or any transition
+     * that an action requested.
+     */
+    if (!transaction.pending && err == 0 && entered && top != NULL && INFINITE_STATE_DEREF(top->completion) != NULL)
+    {
+        infinite_state_machine_transaction_goto(&transaction, INFINITE_STATE_DEREF(top->completion));
+    }
+    int committed = infinite_state_machine_transaction_commit(&transaction);
+#ifdef INFINITE_STATE_PROFILE
+    infinite_state_profile_machine = dispatching;
+#endif
+    return err < 0 ? err : committed;
 }
 
-void infinite_state_machine_jump(struct infinite_state_machine *machine, struct infinite_state *state)
+INFINITE_STATE_API int infinite_state_machine_jump(struct infinite_state_machine *machine, const struct infinite_state *state)
 {
+    struct infinite_state_arena *arena = machine->arena;
+    const struct infinite_state *topology[INFINITE_STATE_MACHINE_MAX_DEPTH];
+    int max_depth = machine->max_depth < INFINITE_STATE_MACHINE_MAX_DEPTH ? machine->max_depth
+                                                                          : INFINITE_STATE_MACHINE_MAX_DEPTH;
+    int depth = infinite_state_machine_forward(state, max_depth, topology);
+    if (depth < 0)
+    {
+        return depth;
+    }
+#ifdef INFINITE_STATE_DEFER
+    /*
+     * Every active state leaves, albeit without exiting; recall all their
+     * deferred events, from sub to super as exiting would.
+     */
+    struct infinite_state_deferral *deferral = machine->deferral;
+    if (deferral != NULL)
+    {
+        for (int depth = machine->depth; depth > 0; depth--)
+        {
+            infinite_state_deferral_recall(deferral, depth - 1);
+        }
+    }
+#endif
+#ifdef INFINITE_STATE_REALTIME
+    struct infinite_state_machine_transaction *transaction = machine->transaction;
+#endif
+#ifdef INFINITE_STATE_ACTIVATIONS
+    unsigned long *activations = machine->activations;
+#endif
     infinite_state_machine_init(machine);
-    machine->depth = infinite_state_topology(state, INFINITE_STATE_MACHINE_MAX_DEPTH, machine->states) - machine->states;
+#ifdef INFINITE_STATE_DEFER
+    machine->deferral = deferral;
+#endif
+#ifdef INFINITE_STATE_REALTIME
+    machine->transaction = transaction;
+#endif
+#ifdef INFINITE_STATE_ACTIVATIONS
+    machine->activations = activations;
+#endif
+    machine->depth = depth;
+    for (depth = 0; depth < machine->depth; depth++)
+    {
+        machine->states[depth] = INFINITE_STATE_REF(topology[depth]);
+#ifdef INFINITE_STATE_ACTIVATIONS
+        if (activations != NULL)
+        {
+            activations[depth]++;
+        }
+#endif
+    }
+    infinite_state_machine_arena(machine, arena);
+    if (arena != NULL)
+    {
+        /*
+         * Truncate the stack where the arena runs out of storage, just as
+         * pushing would fail.
+         */
+        for (depth = 0; depth < machine->depth; depth++)
+        {
+            size_t size = INFINITE_STATE_ALIGN(INFINITE_STATE_DEREF(machine->states[depth])->size);
+            if (arena->size - arena->used < size)
+            {
+                (void)memset(machine->states + depth, 0, (machine->depth - depth) * sizeof(*machine->states));
+                machine->depth = depth;
+                return -ENOMEM;
+            }
+            arena->used += size;
+        }
+    }
+    return 0;
 }
 
-int infinite_state_machine_in(struct infinite_state_machine *machine, struct infinite_state *state)
+INFINITE_STATE_API int infinite_state_machine_in(const struct infinite_state_machine *machine, const struct infinite_state *state)
 {
     if (machine == NULL || state == NULL)
     {
         return -EINVAL;
     }
+    infinite_state_ref ref = INFINITE_STATE_REF(state);
     for (int depth = 0; depth < machine->depth; depth++)
     {
-        if (machine->states[depth] == state)
+        if (machine->states[depth] == ref)
         {
             return 1;
         }
@@ -108,13 +417,14 @@ int infinite_state_machine_in(struct infinite_state_machine *machine, struct inf
     return 0;
 }
 
-int infinite_state_machine_enter(struct infinite_state_machine *machine, struct infinite_state *state)
+int infinite_state_machine_enter(struct infinite_state_machine *machine, const struct infinite_state *state)
 {
     int err;
     if ((err = infinite_state_machine_push(machine, state)) < 0)
     {
         return err;
     }
+    INFINITE_STATE_PROBE3(enter, machine, state, machine->depth);
     /*
      * Run the enter actions *after* the machine stack adds the state.
      * Technically, nothing prevents the action from applying yet another
@@ -130,11 +440,23 @@ int infinite_state_machine_enter(struct infinite_state_machine *machine, struct
 
 int infinite_state_machine_exit(struct infinite_state_machine *machine)
 {
-    struct infinite_state *state = infinite_state_machine_pop(machine);
+    const struct infinite_state *state = infinite_state_machine_pop(machine);
     if (state == NULL)
     {
         return -EINVAL;
     }
+    int depth = machine->depth;
+    INFINITE_STATE_PROBE3(exit, machine, state, depth);
+#ifdef INFINITE_STATE_DEFER
+    /*
+     * Recall the events that the state deferred before its exit actions run,
+     * so that they see the events queued.
+     */
+    if (machine->deferral != NULL)
+    {
+        infinite_state_deferral_recall(machine->deferral, depth);
+    }
+#endif
     /*
      * Run the exit actions *after* the machine stack removes the state. This is
      * by design, as it allows the exit actions to mutate the state of the
@@ -147,35 +469,222 @@ int infinite_state_machine_exit(struct infinite_state_machine *machine)
     {
         state->exit(state, machine);
     }
+    /*
+     * Release the state's local storage only after its exit actions, so that
+     * they can still read or clean up the storage. Then clear the popped
+     * state from the stack. This is not strictly necessary, but it can help
+     * catch use-after-free bugs.
+     */
+    if (machine->arena != NULL)
+    {
+        machine->arena->used -= INFINITE_STATE_ALIGN(state->size);
+    }
+    if (machine->depth <= depth)
+    {
+        machine->states[depth] = INFINITE_STATE_REF(NULL);
+    }
     return 0;
 }
 
-struct infinite_state *infinite_state_machine_top(const struct infinite_state_machine *machine)
+INFINITE_STATE_API void infinite_state_machine_transaction_begin(struct infinite_state_machine_transaction *transaction,
+                                                                 struct infinite_state_machine *machine)
+{
+    transaction->machine = machine;
+    transaction->state = NULL;
+    transaction->pending = 0;
+}
+
+INFINITE_STATE_API void infinite_state_machine_transaction_goto(struct infinite_state_machine_transaction *transaction,
+                                                                const struct infinite_state *state)
+{
+    transaction->state = state;
+    transaction->pending = 1;
+}
+
+INFINITE_STATE_API int infinite_state_machine_transaction_commit(struct infinite_state_machine_transaction *transaction)
+{
+    struct infinite_state_machine *machine = transaction->machine;
+    int err = 0;
+#ifdef INFINITE_STATE_REALTIME
+    /*
+     * An action committing another transaction hands its request to the
+     * transaction already committing rather than recursing.
+     */
+    if (machine->transaction != NULL)
+    {
+        if (machine->transaction != transaction && transaction->pending)
+        {
+            infinite_state_machine_transaction_goto(machine->transaction, transaction->state);
+            transaction->pending = 0;
+        }
+        return 0;
+    }
+    machine->transaction = transaction;
+#endif
+#ifdef INFINITE_STATE_PROFILE
+    /*
+     * Attribute samples during the commit, its actions included, to this
+     * machine; then restore the dispatching machine, if any.
+     */
+    const struct infinite_state_machine *dispatching = infinite_state_profile_machine;
+    infinite_state_profile_machine = machine;
+#endif
+    while (transaction->pending)
+    {
+        const struct infinite_state *state = transaction->state;
+        transaction->pending = 0;
+        if (state == infinite_state_machine_top(machine))
+        {
+            continue;
+        }
+        /*
+         * Compute the new state's forward topology. A state deeper than the
+         * machine fails the request, leaving the machine as it is.
+         */
+        const struct infinite_state *topology[INFINITE_STATE_MACHINE_MAX_DEPTH];
+        int max_depth = machine->max_depth < INFINITE_STATE_MACHINE_MAX_DEPTH ? machine->max_depth
+                                                                              : INFINITE_STATE_MACHINE_MAX_DEPTH;
+        int jump = infinite_state_machine_forward(state, max_depth, topology);
+        if (jump < 0)
+        {
+            if (err == 0)
+            {
+                err = jump;
+            }
+            continue;
+        }
+        /*
+         * Trace, count and cover every pass, whether a goto, a completion, a
+         * request by an action or a direct commit asked for it.
+         */
+        INFINITE_STATE_PROBE3(goto__start, machine, infinite_state_machine_top(machine), state);
+#ifdef INFINITE_STATE_COUNTER
+        infinite_state_counter_record(infinite_state_machine_top(machine), state);
+#endif
+#ifdef INFINITE_STATE_COVERAGE
+        infinite_state_coverage_transition(infinite_state_machine_top(machine), state);
+#endif
+        int depth = 0;
+        while (depth < machine->depth && depth < jump && machine->states[depth] == INFINITE_STATE_REF(topology[depth]))
+        {
+            depth++;
+        }
+        /*
+         * Stop exiting or entering as soon as an action requests another
+         * transition. The next pass recomputes the least common ancestor
+         * against the new request, so states that the new request would exit
+         * again never enter.
+         */
+        while (!transaction->pending && machine->depth > depth)
+        {
+            infinite_state_machine_exit(machine);
+        }
+        int entered = jump > depth;
+        int failed = 0;
+        while (!transaction->pending && !failed && jump > depth)
+        {
+            failed = infinite_state_machine_enter(machine, topology[depth++]);
+        }
+        if (failed < 0 && err == 0)
+        {
+            err = failed;
+        }
+        /*
+         * The innermost state entered completes; its completion transition,
+         * if any, becomes the next request rather than a recursive goto.
+         */
+        if (!transaction->pending && entered && machine->depth == jump)
+        {
+            const struct infinite_state *completion = INFINITE_STATE_DEREF(topology[jump - 1]->completion);
+            if (completion != NULL)
+            {
+                infinite_state_machine_transaction_goto(transaction, completion);
+            }
+        }
+        INFINITE_STATE_PROBE2(goto__done, machine, state);
+    }
+#ifdef INFINITE_STATE_PROFILE
+    infinite_state_profile_machine = dispatching;
+#endif
+#ifdef INFINITE_STATE_REALTIME
+    machine->transaction = NULL;
+#endif
+    return err;
+}
+
+int infinite_state_machine_forward(const struct infinite_state *state, int max_depth,
+                                   const struct infinite_state *topology[])
 {
-    return machine->depth == 0 ? NULL : machine->states[machine->depth - 1];
+    if (infinite_state_depth(state, max_depth + 1) > max_depth)
+    {
+        return -ENOMEM;
+    }
+    int depth = infinite_state_topology(state, max_depth, topology) - topology;
+    depth = infinite_state_machine_initial(topology, depth, max_depth);
+    if (depth == max_depth && depth > 0 && INFINITE_STATE_DEREF(topology[depth - 1]->initial) != NULL)
+    {
+        return -ENOMEM;
+    }
+    return depth;
 }
 
-int infinite_state_machine_push(struct infinite_state_machine *machine, struct infinite_state *state)
+int infinite_state_machine_initial(const struct infinite_state *topology[], int depth, int max_depth)
 {
-    if (machine->depth == INFINITE_STATE_MACHINE_MAX_DEPTH)
+    while (depth > 0 && depth < max_depth && INFINITE_STATE_DEREF(topology[depth - 1]->initial) != NULL)
+    {
+        topology[depth] = INFINITE_STATE_DEREF(topology[depth - 1]->initial);
+        depth++;
+    }
+    return depth;
+}
+
+INFINITE_STATE_API const struct infinite_state *infinite_state_machine_top(const struct infinite_state_machine *machine)
+{
+    return machine->depth == 0 ? NULL : INFINITE_STATE_DEREF(machine->states[machine->depth - 1]);
+}
+
+int infinite_state_machine_push(struct infinite_state_machine *machine, const struct infinite_state *state)
+{
+    if (machine->depth >= machine->max_depth || machine->depth >= INFINITE_STATE_MACHINE_MAX_DEPTH)
     {
         return -ENOMEM;
     }
-    machine->states[machine->depth++] = state;
+    struct infinite_state_arena *arena = machine->arena;
+    if (arena != NULL)
+    {
+        size_t size = INFINITE_STATE_ALIGN(state->size);
+        if (arena->size - arena->used < size)
+        {
+            return -ENOMEM;
+        }
+        arena->used += size;
+    }
+#ifdef INFINITE_STATE_ACTIVATIONS
+    if (machine->activations != NULL)
+    {
+        machine->activations[machine->depth]++;
+    }
+#endif
+    machine->states[machine->depth++] = INFINITE_STATE_REF(state);
+#ifdef INFINITE_STATE_COVERAGE
+    infinite_state_coverage_enter(state);
+#endif
     return 0;
 }
 
-struct infinite_state *infinite_state_machine_pop(struct infinite_state_machine *machine)
+const struct infinite_state *infinite_state_machine_pop(struct infinite_state_machine *machine)
 {
     if (machine->depth == 0)
     {
         return NULL;
     }
-    struct infinite_state *pop = machine->states[--machine->depth];
     /*
-     * Clear the popped state from the stack. This is not strictly necessary,
-     * but it can help catch use-after-free bugs.
+     * Decrement first: INFINITE_STATE_DEREF evaluates its argument twice.
      */
-    machine->states[machine->depth] = NULL;
+    machine->depth--;
+    const struct infinite_state *pop = INFINITE_STATE_DEREF(machine->states[machine->depth]);
+#ifdef INFINITE_STATE_COVERAGE
+    infinite_state_coverage_exit(pop);
+#endif
     return pop;
 }
@@ -0,0 +1,101 @@
+/*
+ * SPDX-FileCopyrightText: 2023, Roy Ratcliffe, Northumberland, United Kingdom
+ * SPDX-License-Identifier: MIT
+ */
+/*!
+ * \file infinite_state_mailbox.c
+ * \brief Mailbox implementation.
+ *
+ * Posting first reserves capacity by incrementing the count, backing out if
+ * the ring is full, then claims the tail's slot. The count never exceeds the
+ * ring's size, so the claimed slot's previous event has already drained. The
+ * slot's sequence publishes the event. Draining releases each slot's capacity
+ * only after reading it. Neither side ever waits for the other; a drain that
+ * meets an unpublished slot stops and resumes next time.
+ */
+
+#include "infinite_state_mailbox.h"
+
+#include <errno.h>
+
+#if ATOMIC_INT_LOCK_FREE != 2
+#error "mailboxes need lock-free atomic integers to post from signal handlers"
+#endif
+
+int infinite_state_mailbox_init(struct infinite_state_mailbox *mailbox, struct infinite_state_machine *machine,
+                                struct infinite_state_mailbox_slot *slots, unsigned size)
+{
+    if (size == 0 || (size & (size - 1)) != 0)
+    {
+        return -EINVAL;
+    }
+    mailbox->machine = machine;
+    mailbox->slots = slots;
+    mailbox->mask = size - 1;
+    atomic_init(&mailbox->count, 0);
+    atomic_init(&mailbox->tail, 0);
+    mailbox->head = 0;
+    for (unsigned index = 0; index < size; index++)
+    {
+        atomic_init(&slots[index].sequence, 0);
+    }
+    return 0;
+}
+
+int infinite_state_mailbox_post(struct infinite_state_mailbox *mailbox, const struct infinite_state *state,
+                                void *data)
+{
+    /*
+     * Acquiring the count synchronises with the drains that released
+     * capacity, hence with their reads of the slots.
+     */
+    if (atomic_fetch_add_explicit(&mailbox->count, 1, memory_order_acq_rel) > mailbox->mask)
+    {
+        atomic_fetch_sub_explicit(&mailbox->count, 1, memory_order_relaxed);
+        return -EAGAIN;
+    }
+    unsigned index = atomic_fetch_add_explicit(&mailbox->tail, 1, memory_order_relaxed);
+    struct infinite_state_mailbox_slot *slot = mailbox->slots + (index & mailbox->mask);
+    slot->state = state;
+    slot->data = data;
+    atomic_store_explicit(&slot->sequence, index + 1, memory_order_release);
+    return 0;
+}
+
+int infinite_state_mailbox_drain(struct infinite_state_mailbox *mailbox, int batch,
+                                 infinite_state_mailbox_dispatch dispatch, void *context)
+{
+    struct infinite_state_machine_transaction transaction;
+    if (dispatch == NULL)
+    {
+        infinite_state_machine_transaction_begin(&transaction, mailbox->machine);
+    }
+    int drained = 0;
+    while (drained < batch)
+    {
+        unsigned head = mailbox->head;
+        struct infinite_state_mailbox_slot *slot = mailbox->slots + (head & mailbox->mask);
+        if (atomic_load_explicit(&slot->sequence, memory_order_acquire) != head + 1)
+        {
+            break;
+        }
+        const struct infinite_state *state = slot->state;
+        void *data = slot->data;
+        mailbox->head = head + 1;
+        atomic_fetch_sub_explicit(&mailbox->count, 1, memory_order_release);
+        if (dispatch == NULL)
+        {
+            infinite_state_machine_transaction_goto(&transaction, state);
+        }
+        else
+        {
+            dispatch(mailbox->machine, state, data, context);
+        }
+        drained++;
+    }
+    if (dispatch == NULL)
+    {
+        infinite_state_machine_transaction_commit(&transaction);
+    }
+    return drained;
+}
@@ -0,0 +1,277 @@
+/*
+ * SPDX-FileCopyrightText: 2023, Roy Ratcliffe, Northumberland, United Kingdom
+ * SPDX-License-Identifier: MIT
+ */
+/*!
+ * \file infinite_state_pool.c
+ * \brief Event pool implementation.
+ *
+ * Free events form singly-linked stacks: one shared per class under the
+ * pool's mutex, and one per class in each thread's cache. A cache refills
+ * from the shared stack, and spills back to it, half its capacity at a time,
+ * so that a thread allocating or releasing steadily takes the mutex once per
+ * many events.
+ */
+
+#include "infinite_state_pool.h"
+
+#include <errno.h>
+#include <stdlib.h>
+
+/*
+ * The payload follows the event's header at the next aligned offset.
+ */
+#define INFINITE_STATE_POOL_HEADER INFINITE_STATE_ALIGN(sizeof(struct infinite_state_pool_event))
+
+/*!
+ * \brief A thread's cache of free events for one pool.
+ */
+struct infinite_state_pool_cache
+{
+    struct infinite_state_pool *pool;
+    struct infinite_state_pool_event *free[INFINITE_STATE_POOL_CLASSES];
+    int count[INFINITE_STATE_POOL_CLASSES];
+};
+
+/*!
+ * \brief Context for draining pooled events through a mailbox's dispatch.
+ */
+struct infinite_state_pool_drain
+{
+    infinite_state_pool_handler handler;
+    void *context;
+};
+
+/*
+ * Moves up to a number of free events from one stack to another.
+ */
+static int infinite_state_pool_move(struct infinite_state_pool_event **from, struct infinite_state_pool_event **to,
+                                    int count)
+{
+    int moved = 0;
+    for (; moved < count && *from != NULL; moved++)
+    {
+        struct infinite_state_pool_event *event = *from;
+        *from = event->next;
+        event->next = *to;
+        *to = event;
+    }
+    return moved;
+}
+
+/*
+ * Returns an exiting thread's cache to its pool.
+ */
+static void infinite_state_pool_flush(void *specific)
+{
+    struct infinite_state_pool_cache *cache = specific;
+    struct infinite_state_pool *pool = cache->pool;
+    pthread_mutex_lock(&pool->mutex);
+    for (int bin = 0; bin < pool->bins; bin++)
+    {
+        infinite_state_pool_move(cache->free + bin, pool->free + bin, cache->count[bin]);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    free(cache);
+}
+
+/*
+ * Finds or creates the calling thread's cache; NULL if out of memory, in
+ * which case the thread uses the shared stacks directly.
+ */
+static struct infinite_state_pool_cache *infinite_state_pool_cache(struct infinite_state_pool *pool)
+{
+    struct infinite_state_pool_cache *cache = pthread_getspecific(pool->key);
+    if (cache == NULL && (cache = calloc(1, sizeof(*cache))) != NULL)
+    {
+        cache->pool = pool;
+        if (pthread_setspecific(pool->key, cache) != 0)
+        {
+            free(cache);
+            cache = NULL;
+        }
+    }
+    return cache;
+}
+
+size_t infinite_state_pool_size(const struct infinite_state_pool_class classes[], int count)
+{
+    size_t size = 0;
+    for (int bin = 0; bin < count; bin++)
+    {
+        size += (INFINITE_STATE_POOL_HEADER + INFINITE_STATE_ALIGN(classes[bin].size)) * classes[bin].count;
+    }
+    return size;
+}
+
+int infinite_state_pool_init(struct infinite_state_pool *pool, const struct infinite_state_pool_class classes[],
+                             int count, void *storage, size_t size)
+{
+    if (count < 0 || count > INFINITE_STATE_POOL_CLASSES || size < infinite_state_pool_size(classes, count))
+    {
+        return -EINVAL;
+    }
+    for (int bin = 1; bin < count; bin++)
+    {
+        if (classes[bin].size <= classes[bin - 1].size)
+        {
+            return -EINVAL;
+        }
+    }
+    int err;
+    if ((err = pthread_mutex_init(&pool->mutex, NULL)) != 0)
+    {
+        return -err;
+    }
+    if ((err = pthread_key_create(&pool->key, infinite_state_pool_flush)) != 0)
+    {
+        pthread_mutex_destroy(&pool->mutex);
+        return -err;
+    }
+    pool->bins = count;
+    unsigned char *next = storage;
+    for (int bin = 0; bin < count; bin++)
+    {
+        pool->sizes[bin] = classes[bin].size;
+        pool->free[bin] = NULL;
+        for (int index = 0; index < classes[bin].count; index++)
+        {
+            struct infinite_state_pool_event *event = (struct infinite_state_pool_event *)next;
+            atomic_init(&event->refs, 0);
+            event->bin = bin;
+            event->pool = pool;
+            event->next = pool->free[bin];
+            pool->free[bin] = event;
+            next += INFINITE_STATE_POOL_HEADER + INFINITE_STATE_ALIGN(classes[bin].size);
+        }
+    }
+    return 0;
+}
+
+void infinite_state_pool_destroy(struct infinite_state_pool *pool)
+{
+    struct infinite_state_pool_cache *cache = pthread_getspecific(pool->key);
+    if (cache != NULL)
+    {
+        pthread_setspecific(pool->key, NULL);
+        infinite_state_pool_flush(cache);
+    }
+    pthread_key_delete(pool->key);
+    pthread_mutex_destroy(&pool->mutex);
+}
+
+struct infinite_state_pool_event *infinite_state_pool_alloc(struct infinite_state_pool *pool, size_t size)
+{
+    int bin = 0;
+    while (bin < pool->bins && pool->sizes[bin] < size)
+    {
+        bin++;
+    }
+    if (bin == pool->bins)
+    {
+        return NULL;
+    }
+    struct infinite_state_pool_event *event = NULL;
+    struct infinite_state_pool_cache *cache = infinite_state_pool_cache(pool);
+    if (cache != NULL && cache->count[bin] == 0)
+    {
+        pthread_mutex_lock(&pool->mutex);
+        cache->count[bin] = infinite_state_pool_move(pool->free + bin, cache->free + bin, INFINITE_STATE_POOL_CACHE / 2);
+        pthread_mutex_unlock(&pool->mutex);
+    }
+    if (cache == NULL)
+    {
+        pthread_mutex_lock(&pool->mutex);
+        infinite_state_pool_move(pool->free + bin, &event, 1);
+        pthread_mutex_unlock(&pool->mutex);
+    }
+    else if (cache->count[bin] > 0)
+    {
+        event = cache->free[bin];
+        cache->free[bin] = event->next;
+        cache->count[bin]--;
+    }
+    if (event != NULL)
+    {
+        event->next = NULL;
+        atomic_store_explicit(&event->refs, 1, memory_order_relaxed);
+    }
+    return event;
+}
+
+void *infinite_state_pool_payload(struct infinite_state_pool_event *event)
+{
+    return (unsigned char *)event + INFINITE_STATE_POOL_HEADER;
+}
+
+void infinite_state_pool_ref(struct infinite_state_pool_event *event)
+{
+    atomic_fetch_add_explicit(&event->refs, 1, memory_order_relaxed);
+}
+
+void infinite_state_pool_unref(struct infinite_state_pool_event *event)
+{
+    /*
+     * Releasing orders this thread's use of the payload before the last
+     * release; the last acquires all the others before recycling.
+     */
+    if (atomic_fetch_sub_explicit(&event->refs, 1, memory_order_acq_rel) != 1)
+    {
+        return;
+    }
+    struct infinite_state_pool *pool = event->pool;
+    int bin = event->bin;
+    struct infinite_state_pool_cache *cache = infinite_state_pool_cache(pool);
+    if (cache == NULL)
+    {
+        pthread_mutex_lock(&pool->mutex);
+        event->next = pool->free[bin];
+        pool->free[bin] = event;
+        pthread_mutex_unlock(&pool->mutex);
+        return;
+    }
+    event->next = cache->free[bin];
+    cache->free[bin] = event;
+    if (++cache->count[bin] > INFINITE_STATE_POOL_CACHE)
+    {
+        pthread_mutex_lock(&pool->mutex);
+        cache->count[bin] -= infinite_state_pool_move(cache->free + bin, pool->free + bin, INFINITE_STATE_POOL_CACHE / 2);
+        pthread_mutex_unlock(&pool->mutex);
+    }
+}
+
+int infinite_state_pool_post(struct infinite_state_mailbox *const mailboxes[], int count,
+                             const struct infinite_state *state, struct infinite_state_pool_event *event)
+{
+    int posted = 0;
+    for (int index = 0; index < count; index++)
+    {
+        /*
+         * Reference the event before posting it; the mailbox's machine may
+         * drain and release it at once.
+         */
+        infinite_state_pool_ref(event);
+        if (infinite_state_mailbox_post(mailboxes[index], state, event) < 0)
+        {
+            infinite_state_pool_unref(event);
+            continue;
+        }
+        posted++;
+    }
+    return posted;
+}
+
+static void infinite_state_pool_dispatch(struct infinite_state_machine *machine, const struct infinite_state *state,
+                                         void *data, void *context)
+{
+    struct infinite_state_pool_drain *drain = context;
+    drain->handler(machine, state, data, drain->context);
+    infinite_state_pool_unref(data);
+}
+
+int infinite_state_pool_drain(struct infinite_state_mailbox *mailbox, int batch, infinite_state_pool_handler handler,
+                              void *context)
+{
+    struct infinite_state_pool_drain drain = {.handler = handler, .context = context};
+    return infinite_state_mailbox_drain(mailbox, batch, infinite_state_pool_dispatch, &drain);
+}
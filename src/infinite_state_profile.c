@@ -0,0 +1,182 @@
+/*
+ * SPDX-FileCopyrightText: 2023, Roy Ratcliffe, Northumberland, United Kingdom
+ * SPDX-License-Identifier: MIT
+ */
+/*!
+ * \file infinite_state_profile.c
+ * \brief Sampling profiler implementation.
+ *
+ * The table uses open addressing keyed by a hash of the sampled path. Each
+ * slot moves from empty to claimed to ready exactly once until reset; only
+ * the thread that claims a slot writes its path. Handlers on other threads
+ * skip claimed slots rather than wait for them.
+ *
+ * Sampling reads the machine's stack without synchronisation. A sample landing
+ * mid-transition may see a partially updated path; at sampling rates, such
+ * samples are rare and harmless.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "infinite_state_profile.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <sys/time.h>
+
+enum
+{
+    EMPTY,
+    CLAIMED,
+    READY
+};
+
+struct path
+{
+    atomic_int status;
+    atomic_ulong count;
+    unsigned long hash;
+    int depth;
+    const struct infinite_state *states[INFINITE_STATE_MACHINE_MAX_DEPTH];
+};
+
+_Thread_local const struct infinite_state_machine *infinite_state_profile_machine;
+
+static struct path paths[INFINITE_STATE_PROFILE_PATHS];
+
+static atomic_ulong dropped;
+
+/*
+ * The SIGPROF action replaced by starting, restored by stopping.
+ */
+static struct sigaction previous;
+
+static void infinite_state_profile_sample(int signal)
+{
+    (void)signal;
+    const struct infinite_state_machine *machine = infinite_state_profile_machine;
+    if (machine == NULL)
+    {
+        return;
+    }
+    const struct infinite_state *states[INFINITE_STATE_MACHINE_MAX_DEPTH];
+    int depth = machine->depth;
+    if (depth > INFINITE_STATE_MACHINE_MAX_DEPTH)
+    {
+        depth = INFINITE_STATE_MACHINE_MAX_DEPTH;
+    }
+    /*
+     * Fowler–Noll–Vo hash of the state addresses.
+     */
+    unsigned long hash = 2166136261UL;
+    for (int level = 0; level < depth; level++)
+    {
+        states[level] = INFINITE_STATE_DEREF(machine->states[level]);
+        hash = (hash ^ (unsigned long)(size_t)states[level]) * 16777619UL;
+    }
+    for (int probe = 0; probe < INFINITE_STATE_PROFILE_PATHS; probe++)
+    {
+        struct path *path = paths + (hash + probe) % INFINITE_STATE_PROFILE_PATHS;
+        int status = atomic_load_explicit(&path->status, memory_order_acquire);
+        if (status == EMPTY &&
+            atomic_compare_exchange_strong_explicit(&path->status, &status, CLAIMED, memory_order_acquire,
+                                                    memory_order_relaxed))
+        {
+            path->hash = hash;
+            path->depth = depth;
+            (void)memcpy(path->states, states, depth * sizeof(*states));
+            atomic_store_explicit(&path->count, 1, memory_order_relaxed);
+            atomic_store_explicit(&path->status, READY, memory_order_release);
+            return;
+        }
+        if (status == READY && path->hash == hash && path->depth == depth &&
+            memcmp(path->states, states, depth * sizeof(*states)) == 0)
+        {
+            atomic_fetch_add_explicit(&path->count, 1, memory_order_relaxed);
+            return;
+        }
+    }
+    atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+}
+
+int infinite_state_profile_start(int hz)
+{
+    if (hz <= 0 || hz > 1000000)
+    {
+        return -EINVAL;
+    }
+    struct sigaction action;
+    (void)memset(&action, 0, sizeof(action));
+    action.sa_handler = infinite_state_profile_sample;
+    action.sa_flags = SA_RESTART;
+    (void)sigemptyset(&action.sa_mask);
+    if (sigaction(SIGPROF, &action, &previous) < 0)
+    {
+        return -errno;
+    }
+    long period = 1000000L / hz;
+    struct itimerval timer = {.it_interval = {.tv_sec = period / 1000000L, .tv_usec = period % 1000000L}};
+    timer.it_value = timer.it_interval;
+    if (setitimer(ITIMER_PROF, &timer, NULL) < 0)
+    {
+        int err = errno;
+        (void)sigaction(SIGPROF, &previous, NULL);
+        return -err;
+    }
+    return 0;
+}
+
+void infinite_state_profile_stop(void)
+{
+    struct itimerval timer;
+    (void)memset(&timer, 0, sizeof(timer));
+    (void)setitimer(ITIMER_PROF, &timer, NULL);
+    (void)sigaction(SIGPROF, &previous, NULL);
+}
+
+void infinite_state_profile_reset(void)
+{
+    for (int index = 0; index < INFINITE_STATE_PROFILE_PATHS; index++)
+    {
+        atomic_store_explicit(&paths[index].status, EMPTY, memory_order_relaxed);
+    }
+    atomic_store_explicit(&dropped, 0, memory_order_relaxed);
+}
+
+unsigned long infinite_state_profile_dropped(void)
+{
+    return atomic_load_explicit(&dropped, memory_order_relaxed);
+}
+
+int infinite_state_profile_dump(FILE *file, const char *(*name)(const struct infinite_state *state))
+{
+    int dumped = 0;
+    for (int index = 0; index < INFINITE_STATE_PROFILE_PATHS; index++)
+    {
+        struct path *path = paths + index;
+        if (atomic_load_explicit(&path->status, memory_order_acquire) != READY)
+        {
+            continue;
+        }
+        for (int level = 0; level < path->depth; level++)
+        {
+            const struct infinite_state *state = path->states[level];
+            if (level > 0 && fputc(';', file) == EOF)
+            {
+                return -EIO;
+            }
+            if ((name != NULL ? fputs(name(state), file) : fprintf(file, "%p", (const void *)state)) < 0)
+            {
+                return -EIO;
+            }
+        }
+        if (fprintf(file, " %lu\n", atomic_load_explicit(&path->count, memory_order_relaxed)) < 0)
+        {
+            return -EIO;
+        }
+        dumped++;
+    }
+    return dumped;
+}
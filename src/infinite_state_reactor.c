@@ -0,0 +1,193 @@
+/*
+ * SPDX-FileCopyrightText: 2023, Roy Ratcliffe, Northumberland, United Kingdom
+ * SPDX-License-Identifier: MIT
+ */
+/*!
+ * \file infinite_state_reactor.c
+ * \brief Readiness reactor implementation using epoll.
+ *
+ * Each epoll registration carries its source's address. The reactor registers
+ * its own wake-up event file descriptor with the reactor's address instead,
+ * which no source can share. Waiting fills a batch of events on the stack;
+ * removing a source clears its pending events from that batch, so that no
+ * handler sees a source after its removal.
+ */
+
+#define _GNU_SOURCE
+
+#include "infinite_state_reactor.h"
+
+#include <errno.h>
+#include <sched.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+static uint32_t infinite_state_reactor_interest(unsigned events)
+{
+    uint32_t interest = EPOLLRDHUP;
+    if (events & INFINITE_STATE_REACTOR_READ)
+    {
+        interest |= EPOLLIN;
+    }
+    if (events & INFINITE_STATE_REACTOR_WRITE)
+    {
+        interest |= EPOLLOUT;
+    }
+    return interest;
+}
+
+static unsigned infinite_state_reactor_ready(uint32_t ready)
+{
+    unsigned events = 0;
+    if (ready & EPOLLIN)
+    {
+        events |= INFINITE_STATE_REACTOR_READ;
+    }
+    if (ready & EPOLLOUT)
+    {
+        events |= INFINITE_STATE_REACTOR_WRITE;
+    }
+    if (ready & (EPOLLHUP | EPOLLRDHUP))
+    {
+        events |= INFINITE_STATE_REACTOR_HANGUP;
+    }
+    if (ready & EPOLLERR)
+    {
+        events |= INFINITE_STATE_REACTOR_ERROR;
+    }
+    return events;
+}
+
+int infinite_state_reactor_init(struct infinite_state_reactor *reactor)
+{
+    reactor->batch = NULL;
+    reactor->count = 0;
+    if ((reactor->epoll = epoll_create1(EPOLL_CLOEXEC)) < 0)
+    {
+        return -errno;
+    }
+    if ((reactor->wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0)
+    {
+        int err = -errno;
+        close(reactor->epoll);
+        return err;
+    }
+    struct epoll_event event = {.events = EPOLLIN, .data.ptr = reactor};
+    if (epoll_ctl(reactor->epoll, EPOLL_CTL_ADD, reactor->wake, &event) < 0)
+    {
+        int err = -errno;
+        infinite_state_reactor_close(reactor);
+        return err;
+    }
+    return 0;
+}
+
+void infinite_state_reactor_close(struct infinite_state_reactor *reactor)
+{
+    close(reactor->wake);
+    close(reactor->epoll);
+    reactor->wake = reactor->epoll = -1;
+}
+
+int infinite_state_reactor_add(struct infinite_state_reactor *reactor, struct infinite_state_reactor_source *source,
+                               unsigned events)
+{
+    struct epoll_event event = {.events = infinite_state_reactor_interest(events), .data.ptr = source};
+    return epoll_ctl(reactor->epoll, EPOLL_CTL_ADD, source->fd, &event) < 0 ? -errno : 0;
+}
+
+int infinite_state_reactor_modify(struct infinite_state_reactor *reactor, struct infinite_state_reactor_source *source,
+                                  unsigned events)
+{
+    struct epoll_event event = {.events = infinite_state_reactor_interest(events), .data.ptr = source};
+    return epoll_ctl(reactor->epoll, EPOLL_CTL_MOD, source->fd, &event) < 0 ? -errno : 0;
+}
+
+int infinite_state_reactor_remove(struct infinite_state_reactor *reactor, struct infinite_state_reactor_source *source)
+{
+    if (epoll_ctl(reactor->epoll, EPOLL_CTL_DEL, source->fd, NULL) < 0)
+    {
+        return -errno;
+    }
+    struct epoll_event *batch = reactor->batch;
+    for (int index = 0; batch != NULL && index < reactor->count; index++)
+    {
+        if (batch[index].data.ptr == source)
+        {
+            batch[index].data.ptr = NULL;
+        }
+    }
+    return 0;
+}
+
+int infinite_state_reactor_poll(struct infinite_state_reactor *reactor, int timeout)
+{
+    struct epoll_event batch[INFINITE_STATE_REACTOR_BATCH];
+    int count = epoll_wait(reactor->epoll, batch, INFINITE_STATE_REACTOR_BATCH, timeout);
+    if (count < 0)
+    {
+        return errno == EINTR ? 0 : -errno;
+    }
+    reactor->batch = batch;
+    reactor->count = count;
+    int dispatched = 0;
+    int stopped = 0;
+    for (int index = 0; index < count; index++)
+    {
+        struct infinite_state_reactor_source *source = batch[index].data.ptr;
+        if (source == NULL)
+        {
+            continue;
+        }
+        if (source == (void *)reactor)
+        {
+            uint64_t wakes;
+            while (read(reactor->wake, &wakes, sizeof(wakes)) > 0)
+            {
+            }
+            stopped = 1;
+            continue;
+        }
+        source->dispatch(source, infinite_state_reactor_ready(batch[index].events));
+        dispatched++;
+    }
+    reactor->batch = NULL;
+    reactor->count = 0;
+    return stopped ? -ECANCELED : dispatched;
+}
+
+int infinite_state_reactor_run(struct infinite_state_reactor *reactor)
+{
+    int err;
+    while ((err = infinite_state_reactor_poll(reactor, -1)) >= 0)
+    {
+    }
+    return err == -ECANCELED ? 0 : err;
+}
+
+void infinite_state_reactor_stop(struct infinite_state_reactor *reactor)
+{
+    /*
+     * Preserve errno for the sake of signal handlers. A failed write means the
+     * counter is saturated; the reactor is already waking.
+     */
+    int err = errno;
+    uint64_t wake = 1;
+    ssize_t written = write(reactor->wake, &wake, sizeof(wake));
+    (void)written;
+    errno = err;
+}
+
+int infinite_state_reactor_pin(int core)
+{
+    if (core < 0 || core >= CPU_SETSIZE)
+    {
+        return -EINVAL;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    return sched_setaffinity(0, sizeof(set), &set) < 0 ? -errno : 0;
+}
@@ -0,0 +1,132 @@
+/*
+ * SPDX-FileCopyrightText: 2023, Roy Ratcliffe, Northumberland, United Kingdom
+ * SPDX-License-Identifier: MIT
+ */
+/*!
+ * \file infinite_state_simulator.c
+ * \brief Discrete-event simulator implementation.
+ *
+ * The event queue is an implicit binary min-heap keyed by time then sequence.
+ * The sequence makes every key unique, so the firing order is total and
+ * independent of the heap's internal arrangement.
+ */
+
+#include "infinite_state_simulator.h"
+
+#include <errno.h>
+
+static int infinite_state_simulator_before(const struct infinite_state_simulator_event *event,
+                                           const struct infinite_state_simulator_event *other)
+{
+    return event->time < other->time || (event->time == other->time && event->sequence < other->sequence);
+}
+
+void infinite_state_simulator_init(struct infinite_state_simulator *simulator,
+                                   struct infinite_state_simulator_event *events, int size)
+{
+    simulator->now = 0;
+    simulator->sequence = 0;
+    simulator->events = events;
+    simulator->count = 0;
+    simulator->size = size;
+}
+
+int64_t infinite_state_simulator_schedule(struct infinite_state_simulator *simulator, uint64_t delay,
+                                          struct infinite_state_machine *machine, const struct infinite_state *state,
+                                          infinite_state_simulator_fire fire, void *context)
+{
+    if (simulator->count == simulator->size)
+    {
+        return -ENOMEM;
+    }
+    struct infinite_state_simulator_event event = {
+        .time = simulator->now + delay,
+        .sequence = simulator->sequence++,
+        .machine = machine,
+        .state = state,
+#ifdef INFINITE_STATE_ACTIVATIONS
+        .activation = infinite_state_machine_activation(machine, state),
+#endif
+        .fire = fire,
+        .context = context,
+    };
+    /*
+     * Sift up from the new leaf.
+     */
+    struct infinite_state_simulator_event *events = simulator->events;
+    int index = simulator->count++;
+    while (index > 0)
+    {
+        int parent = (index - 1) / 2;
+        if (!infinite_state_simulator_before(&event, events + parent))
+        {
+            break;
+        }
+        events[index] = events[parent];
+        index = parent;
+    }
+    events[index] = event;
+    return (int64_t)event.sequence;
+}
+
+int infinite_state_simulator_step(struct infinite_state_simulator *simulator)
+{
+    if (simulator->count == 0)
+    {
+        return -ENOENT;
+    }
+    struct infinite_state_simulator_event *events = simulator->events;
+    struct infinite_state_simulator_event event = events[0];
+    /*
+     * Sift the last leaf down from the root.
+     */
+    struct infinite_state_simulator_event last = events[--simulator->count];
+    int count = simulator->count;
+    int index = 0;
+    for (;;)
+    {
+        int child = 2 * index + 1;
+        if (child >= count)
+        {
+            break;
+        }
+        if (child + 1 < count && infinite_state_simulator_before(events + child + 1, events + child))
+        {
+            child++;
+        }
+        if (!infinite_state_simulator_before(events + child, &last))
+        {
+            break;
+        }
+        events[index] = events[child];
+        index = child;
+    }
+    events[index] = last;
+    simulator->now = event.time;
+    if (event.state != NULL && infinite_state_machine_in(event.machine, event.state) != 1)
+    {
+        return 0;
+    }
+#ifdef INFINITE_STATE_ACTIVATIONS
+    if (event.state != NULL && infinite_state_machine_activation(event.machine, event.state) != event.activation)
+    {
+        return 0;
+    }
+#endif
+    event.fire(simulator, &event);
+    return 1;
+}
+
+uint64_t infinite_state_simulator_run(struct infinite_state_simulator *simulator, uint64_t until)
+{
+    uint64_t fired = 0;
+    while (simulator->count > 0 && simulator->events[0].time <= until)
+    {
+        fired += infinite_state_simulator_step(simulator);
+    }
+    if (simulator->now < until)
+    {
+        simulator->now = until;
+    }
+    return fired;
+}
@@ -0,0 +1,133 @@
+/*
+ * SPDX-FileCopyrightText: 2023, Roy Ratcliffe, Northumberland, United Kingdom
+ * SPDX-License-Identifier: MIT
+ */
+/*!
+ * \file infinite_state_wcet.c
+ * \brief Worst-case step analysis implementation.
+ *
+ * Replays the commit's arithmetic without running any actions: the common
+ * prefix of the active and forward topologies gives the exits and enters of
+ * each pass, and the innermost state entered gives the next pass, if any.
+ * Analysis is an offline or start-up operation; it favours simplicity.
+ */
+
+#include "infinite_state_wcet.h"
+#include "infinite_state_machine.h"
+
+#include <errno.h>
+#include <string.h>
+
+/*
+ * Writes a state's forward topology extended through its initial sub-states,
+ * as the commit computes it; -ENOMEM if deeper than the machine, where the
+ * commit fails the request.
+ */
+static int infinite_state_wcet_path(const struct infinite_state *state, int max_depth,
+                                    const struct infinite_state **path)
+{
+    if (infinite_state_depth(state, max_depth + 1) > max_depth)
+    {
+        return -ENOMEM;
+    }
+    int depth = infinite_state_topology(state, max_depth, path) - path;
+    while (depth > 0 && INFINITE_STATE_DEREF(path[depth - 1]->initial) != NULL)
+    {
+        if (depth == max_depth)
+        {
+            return -ENOMEM;
+        }
+        path[depth] = INFINITE_STATE_DEREF(path[depth - 1]->initial);
+        depth++;
+    }
+    return depth;
+}
+
+int infinite_state_wcet(const struct infinite_state *const states[], int count, int max_depth,
+                        const struct infinite_state *target, struct infinite_state_wcet *wcet)
+{
+    if (count < 0 || max_depth < 0 || max_depth > INFINITE_STATE_MACHINE_MAX_DEPTH)
+    {
+        return -EINVAL;
+    }
+    *wcet = (struct infinite_state_wcet){0};
+    for (int source = -1; source < count; source++)
+    {
+        const struct infinite_state *active[INFINITE_STATE_MACHINE_MAX_DEPTH];
+        int depth = source < 0 ? 0 : infinite_state_wcet_path(states[source], max_depth, active);
+        if (depth < 0)
+        {
+            /*
+             * The machine never rests in a state deeper than itself.
+             */
+            continue;
+        }
+        struct infinite_state_wcet at = {0};
+        for (const struct infinite_state *to = target;;)
+        {
+            /*
+             * Going to the innermost active state does nothing.
+             */
+            if (to == (depth == 0 ? NULL : active[depth - 1]))
+            {
+                break;
+            }
+            if (at.passes++ > count)
+            {
+                return -ELOOP;
+            }
+            const struct infinite_state *next[INFINITE_STATE_MACHINE_MAX_DEPTH];
+            int jump = infinite_state_wcet_path(to, max_depth, next);
+            if (jump < 0)
+            {
+                return jump;
+            }
+            int common = 0;
+            while (common < depth && common < jump && active[common] == next[common])
+            {
+                common++;
+            }
+            at.exits += depth - common;
+            at.enters += jump - common;
+            (void)memcpy(active, next, jump * sizeof(*next));
+            depth = jump;
+            if (jump == common || (to = INFINITE_STATE_DEREF(next[jump - 1]->completion)) == NULL)
+            {
+                break;
+            }
+        }
+        at.steps = at.exits + at.enters;
+        wcet->exits = at.exits > wcet->exits ? at.exits : wcet->exits;
+        wcet->enters = at.enters > wcet->enters ? at.enters : wcet->enters;
+        wcet->passes = at.passes > wcet->passes ? at.passes : wcet->passes;
+        wcet->steps = at.steps > wcet->steps ? at.steps : wcet->steps;
+    }
+    return wcet->steps;
+}
+
+int infinite_state_wcet_report(FILE *file, const struct infinite_state *const states[], int count, int max_depth,
+                               const char *(*name)(const void *state))
+{
+    if (fprintf(file, "state exits enters passes steps\n") < 0)
+    {
+        return -EIO;
+    }
+    int worst = 0;
+    for (int index = 0; index < count; index++)
+    {
+        struct infinite_state_wcet wcet;
+        int steps = infinite_state_wcet(states, count, max_depth, states[index], &wcet);
+        if (steps < 0)
+        {
+            return steps;
+        }
+        if ((name != NULL ? fprintf(file, "%s", name(states[index])) : fprintf(file, "%p", (const void *)states[index])) <
+                0 ||
+            fprintf(file, " %d %d %d %d\n", wcet.exits, wcet.enters, wcet.passes, wcet.steps) < 0)
+        {
+            return -EIO;
+        }
+        worst = steps > worst ? steps : worst;
+    }
+    return worst;
+}
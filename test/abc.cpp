@@ -2,6 +2,7 @@
 
 #include <cassert>
 #include <iostream>
+#include <stdexcept>
 
 using namespace std;
 
@@ -14,6 +15,9 @@ static my_state b = {&a, "b"};
 static my_state c = {&b, "c"};
 static my_state d = {&a, "d"};
 
+static my_state x = {nullptr, "x"};
+static my_state y = {&x, "y"};
+
 static infinite::state_machine<my_state> ism;
 
 ostream &operator<<(ostream &os, const my_state *s) {
@@ -39,7 +43,7 @@ operator<<(ostream &os,
   return os;
 }
 
-extern "C" int test_abc() {
+extern "C" int test_abc(int argc, char *argv[]) {
   cout << ism.go(&c) << endl;
   assert(ism.at() == &c);
   assert(ism.in(&a));
@@ -55,6 +59,75 @@ extern "C" int test_abc() {
   assert(!ism.in(&b));
   assert(!ism.in(&c));
   cout << "transition to c: " << ism.go(&c) << endl;
-  cout << "transition to d: " << ism.go(&d) << endl;
+  transition = ism.go(&d);
+  cout << "transition to d: " << transition << endl;
+  assert(transition.exits.size() == 2);
+  assert(transition.enters.size() == 1);
+  assert(transition.enters[0] == &d);
+  // A sealed index answers ancestry and least common ancestors.
+  infinite::state_index<my_state> index{&c, &d};
+  assert(index.contains(&a));
+  assert(!index.contains(&x));
+  assert(index.depth(&a) == 0);
+  assert(index.depth(&c) == 2);
+  assert(index.is_ancestor(&a, &c));
+  assert(index.is_ancestor(&c, &c));
+  assert(!index.is_ancestor(&c, &a));
+  assert(!index.is_ancestor(&d, &c));
+  assert(index.lca(&c, &d) == &a);
+  assert(index.lca(&b, &c) == &b);
+  assert(index.lca(&d, &d) == &d);
+  infinite::state_machine<my_state> indexed(&index);
+  indexed.go(&c);
+  transition = indexed.go(&d);
+  assert(transition.exits.size() == 2);
+  assert(transition.enters.size() == 1);
+  assert(indexed.at() == &d);
+  assert(indexed.in(&a));
+  transition = indexed.go(&a);
+  assert(transition.exits.size() == 1);
+  assert(transition.enters.empty());
+  // Transitions by kind from composite a, with d or nothing within it.
+  using kind = infinite::state_machine<my_state>::transition_kind;
+  transition = indexed.go(&a, &c, kind::local);
+  assert(transition.exits.empty());
+  assert(transition.enters.size() == 2 && transition.enters[0] == &b);
+  transition = indexed.go(&a, nullptr, kind::internal);
+  assert(transition.exits.empty() && transition.enters.empty());
+  transition = ism.go(&a, &c, kind::local);
+  assert(transition.exits.size() == 1 && transition.exits[0] == &d);
+  assert(transition.enters.size() == 2 && ism.at() == &c);
+  transition = ism.go(&b, &b, kind::external);
+  cout << "external transition to b: " << transition << endl;
+  assert(transition.exits.size() == 2 && transition.exits[1] == &b);
+  assert(transition.enters.size() == 1 && transition.enters[0] == &b);
+  transition = ism.go(&b, &d, kind::local);
+  assert(transition.exits.size() == 1 && transition.enters.size() == 1);
+  assert(ism.at() == &d);
+  bool active = true;
+  try {
+    ism.go(&b, &c, kind::local);
+  } catch (const invalid_argument &) {
+    active = false;
+  }
+  assert(!active);
+  // A cyclic topology terminates: x and y are super-states of each other.
+  x.super = &y;
+  cout << "transition to y: " << ism.go(&y) << endl;
+  assert(ism.at() == &y);
+  assert(ism.in(&x));
+  assert(!ism.in(&a));
+  transition = ism.go(&x);
+  cout << "transition to x: " << transition << endl;
+  assert(ism.at() == &x);
+  assert(ism.in(&y));
+  bool sealed = true;
+  try {
+    infinite::state_index<my_state>{&x};
+  } catch (const invalid_argument &) {
+    sealed = false;
+  }
+  assert(!sealed);
+  x.super = nullptr;
   return 0;
 }
@@ -0,0 +1,46 @@
+#include "infinite_configuration.hpp"
+
+#include <cassert>
+
+struct my_state : infinite::state<my_state> {
+  const char *name;
+};
+
+static my_state a = {nullptr, "a"};
+static my_state b = {&a, "b"};
+static my_state c = {&b, "c"};
+static my_state d = {&a, "d"};
+
+extern "C" int test_configuration(int argc, char *argv[]) {
+  infinite::configuration_pool<my_state> pool;
+  infinite::shared_state_machine<my_state> ism(pool), other(pool);
+  static_assert(sizeof(ism) == sizeof(void *));
+  assert(ism.at() == nullptr);
+  assert(ism.configured() == pool.empty());
+  auto &transition = ism.go(&c);
+  assert(transition.exits.empty());
+  assert(transition.enters.size() == 3);
+  assert(ism.at() == &c);
+  assert(ism.in(&a));
+  assert(ism.in(&b));
+  assert(!ism.in(&d));
+  assert(ism.configured()->depth() == 3);
+  // Equal configurations share the same address.
+  other.go(&b);
+  other.go(&c);
+  assert(other.configured() == ism.configured());
+  assert(pool.size() == 4);
+  // Repeated transitions reuse the memoised result.
+  auto &to_d = ism.go(&d);
+  assert(to_d.exits.size() == 2);
+  assert(to_d.exits[0] == &c);
+  assert(to_d.exits[1] == &b);
+  assert(to_d.enters.size() == 1);
+  assert(to_d.enters[0] == &d);
+  assert(&other.go(&d) == &to_d);
+  assert(other.configured() == ism.configured());
+  assert(pool.size() == 5);
+  ism.go(nullptr);
+  assert(ism.configured() == pool.empty());
+  return 0;
+}
@@ -0,0 +1,71 @@
+#include "infinite_state_counter.h"
+#include "infinite_state_machine.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+
+/*
+ * One topology object, so that compressed references can address its states.
+ */
+struct topology {
+  struct infinite_state a, b, c;
+};
+
+static const struct topology topology = {
+    .b.super = INFINITE_STATE_REF_OF(struct topology, topology, a),
+    .c.super = INFINITE_STATE_REF_OF(struct topology, topology, a)};
+
+static void *hop(void *arg) {
+  INFINITE_STATE_MACHINE(ism, 2);
+  infinite_state_machine_goto(&ism.machine, &topology.b);
+  infinite_state_machine_goto(&ism.machine, &topology.b);
+  for (int i = 0; i < 100; i++) {
+    infinite_state_machine_goto(&ism.machine, &topology.c);
+    infinite_state_machine_goto(&ism.machine, &topology.b);
+  }
+  return arg;
+}
+
+static const char *name(const void *state) {
+  return state == &topology.a   ? "a"
+         : state == &topology.b ? "b"
+         : state == &topology.c ? "c"
+                                : "?";
+}
+
+int test_counter() {
+#if INFINITE_STATE_REF_BITS
+  infinite_state_base = &topology;
+#endif
+  infinite_state_counter_reset();
+  pthread_t threads[2];
+  for (int i = 0; i < 2; i++)
+    assert(pthread_create(threads + i, NULL, hop, NULL) == 0);
+  for (int i = 0; i < 2; i++)
+    assert(pthread_join(threads[i], NULL) == 0);
+  /*
+   * Threads coming and going one at a time reuse the shards released by
+   * exited threads, adding to their counts.
+   */
+  for (int i = 0; i < 2; i++) {
+    assert(pthread_create(threads, NULL, hop, NULL) == 0);
+    assert(pthread_join(threads[0], NULL) == 0);
+  }
+  /*
+   * All shards merge: none to b four times, b to c and c to b 400 times. Going
+   * to the current state counts nothing.
+   */
+  struct infinite_state_counter counters[8];
+  int merged = infinite_state_counter_merge(counters, 8);
+  assert(merged == 3);
+  for (int i = 0; i < merged; i++) {
+    if (counters[i].from == NULL)
+      assert(counters[i].to == &topology.b && counters[i].count == 4);
+    else
+      assert(counters[i].count == 400);
+  }
+  assert(infinite_state_counter_dump(stdout, name) == 3);
+  assert(infinite_state_counter_dropped() == 0);
+  return 0;
+}
@@ -0,0 +1,68 @@
+#include "infinite_state_coverage.h"
+#include "infinite_state_machine.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+/*
+ * One topology object, so that compressed references can address its states.
+ */
+struct topology {
+  struct infinite_state a, b, c, d;
+};
+
+static const struct topology topology = {
+    .b.super = INFINITE_STATE_REF_OF(struct topology, topology, a),
+    .c.super = INFINITE_STATE_REF_OF(struct topology, topology, a)};
+
+static const char *name(const void *state) {
+  return state == &topology.a   ? "a"
+         : state == &topology.b ? "b"
+         : state == &topology.c ? "c"
+                                : "d";
+}
+
+int test_coverage() {
+#if INFINITE_STATE_REF_BITS
+  infinite_state_base = &topology;
+#endif
+  infinite_state_coverage_reset();
+  assert(infinite_state_coverage_bits() == 0);
+  static INFINITE_STATE_MACHINE(ism, 2);
+  infinite_state_machine_goto(&ism.machine, &topology.b);
+  infinite_state_machine_goto(&ism.machine, &topology.c);
+  /*
+   * Entered a, b and c; exited b. None to b and b to c. Only covered bits are
+   * asserted: an uncovered state or transition may share a covered one's bit.
+   */
+  assert(infinite_state_coverage_entered(&topology.a));
+  assert(infinite_state_coverage_entered(&topology.b));
+  assert(infinite_state_coverage_entered(&topology.c));
+  assert(infinite_state_coverage_exited(&topology.b));
+  assert(infinite_state_coverage_transitioned(NULL, &topology.b));
+  assert(infinite_state_coverage_transitioned(&topology.b, &topology.c));
+  /*
+   * Six bits, fewer should any hashes collide. The no-op from c to c covers
+   * nothing. Going back to b exits c and covers c to b; repeating covered
+   * transitions sets no new bits.
+   */
+  size_t bits = infinite_state_coverage_bits();
+  assert(bits > 0 && bits <= 6);
+  infinite_state_machine_goto(&ism.machine, &topology.c);
+  assert(infinite_state_coverage_bits() == bits);
+  infinite_state_machine_goto(&ism.machine, &topology.b);
+  infinite_state_machine_goto(&ism.machine, &topology.c);
+  assert(infinite_state_coverage_exited(&topology.c));
+  assert(infinite_state_coverage_transitioned(&topology.c, &topology.b));
+  bits = infinite_state_coverage_bits();
+  infinite_state_machine_goto(&ism.machine, &topology.b);
+  infinite_state_machine_goto(&ism.machine, &topology.c);
+  assert(infinite_state_coverage_bits() == bits);
+  const void *states[] = {&topology.a, &topology.b, &topology.c, &topology.d};
+  /*
+   * At least the two covered transitions between the states, more
+   * should any hashes collide.
+   */
+  assert(infinite_state_coverage_dump(stdout, states, 4, name) >= 2);
+  return 0;
+}
@@ -0,0 +1,78 @@
+#include "infinite_state_data.hpp"
+
+#include <cassert>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+struct counter {
+  static int live;
+  int cycling = 2;
+  counter() { live++; }
+  ~counter() { live--; }
+};
+
+int counter::live = 0;
+
+struct parser {
+  std::string buffer;
+};
+
+struct failing {
+  failing() { throw std::runtime_error("failing"); }
+};
+
+using data_type = std::variant<std::monostate, counter, parser, failing>;
+
+struct data_state : infinite::state<data_state> {
+  void (*emplace)(data_type &);
+};
+
+static data_state starting = {nullptr, infinite::emplace<parser, data_type>};
+static data_state igniting = {&starting, infinite::emplace<counter, data_type>};
+static data_state cranking = {&starting, infinite::emplace<counter, data_type>};
+static data_state stalling = {&starting, infinite::emplace<failing, data_type>};
+static data_state running = {nullptr, nullptr};
+
+using data_machine =
+    infinite::data_state_machine<data_state, counter, parser, failing>;
+
+// The base go() would bypass the data; it is not reachable.
+static_assert(!std::is_convertible_v<data_machine *,
+                                     infinite::state_machine<data_state> *>);
+
+extern "C" int test_data(int argc, char *argv[]) {
+  data_machine ism;
+  ism.go(&igniting);
+  assert(counter::live == 1);
+  assert(ism.at() == &igniting && ism.in(&starting) && ism.depth() == 2);
+  assert(ism.get<parser>(&starting) != nullptr);
+  assert(ism.get<counter>(&starting) == nullptr);
+  counter *igniting_counter = ism.get<counter>(&igniting);
+  assert(igniting_counter && igniting_counter->cycling == 2);
+  ism.get<parser>(&starting)->buffer = "spark";
+  ism.go(&cranking);
+  assert(counter::live == 1);
+  assert(ism.get<counter>(&igniting) == nullptr);
+  assert(ism.get<counter>(&cranking)->cycling == 2);
+  // The super-state's data survives transitions between its sub-states.
+  assert(ism.get<parser>(&starting)->buffer == "spark");
+  ism.go(&running);
+  assert(counter::live == 0);
+  assert(ism.data(&starting) == nullptr);
+  assert(std::holds_alternative<std::monostate>(*ism.data(&running)));
+  // Failing to construct a state's data leaves the state unentered.
+  bool thrown = false;
+  try {
+    ism.go(&stalling);
+  } catch (const std::runtime_error &) {
+    thrown = true;
+  }
+  assert(thrown);
+  assert(ism.at() == &starting && ism.depth() == 1 && !ism.in(&stalling));
+  assert(ism.data(&stalling) == nullptr);
+  assert(ism.get<parser>(&starting) != nullptr);
+  ism.go(&igniting);
+  assert(counter::live == 1 && ism.get<counter>(&igniting) != nullptr);
+  return 0;
+}
@@ -1,12 +1,16 @@
 #include "infinite_state_machine.h"
+#ifdef INFINITE_STATE_COVERAGE
+#include "infinite_state_coverage.h"
+#endif
 
 #include <assert.h>
+#include <errno.h>
 #include <stddef.h>
 #include <stdio.h>
 
-static void enter_action(struct infinite_state *state,
+static void enter_action(const struct infinite_state *state,
                          struct infinite_state_machine *machine);
-static void exit_action(struct infinite_state *state,
+static void exit_action(const struct infinite_state *state,
                         struct infinite_state_machine *machine);
 
 struct state {
@@ -31,33 +35,209 @@ static struct state g = {.name = "g",
                          .infinite.enter = enter_action,
                          .infinite.exit = exit_action};
 
-static struct infinite_state_machine ism;
+static INFINITE_STATE_MACHINE(ism, 3);
+
+static INFINITE_STATE_MACHINE(shallow, 2);
+
+static int entered, exited;
+
+static void *exited_data;
 
 int test_def() {
-  infinite_state_machine_init(&ism);
-  infinite_state_machine_goto(&ism, &f.infinite);
-  assert(infinite_state_machine_in(&ism, &d.infinite) == 1);
-  assert(infinite_state_machine_in(&ism, &e.infinite) == 1);
-  assert(infinite_state_machine_in(&ism, &f.infinite) == 1);
-  assert(infinite_state_machine_in(&ism, &g.infinite) == 0);
-  infinite_state_machine_goto(&ism, &g.infinite);
-  assert(infinite_state_machine_in(&ism, &d.infinite) == 1);
-  assert(infinite_state_machine_in(&ism, &e.infinite) == 0);
-  assert(infinite_state_machine_in(&ism, &f.infinite) == 0);
-  assert(infinite_state_machine_in(&ism, &g.infinite) == 1);
+  /*
+   * The machine's maximum depth matches the topology's deepest state.
+   */
+  assert(infinite_state_depth(&f.infinite, INFINITE_STATE_MACHINE_MAX_DEPTH) == 3);
+  assert(infinite_state_depth(&g.infinite, INFINITE_STATE_MACHINE_MAX_DEPTH) == 2);
+  assert(sizeof(ism) == INFINITE_STATE_MACHINE_SIZE(3));
+  infinite_state_machine_init(&ism.machine);
+  infinite_state_machine_goto(&ism.machine, &f.infinite);
+  assert(infinite_state_machine_in(&ism.machine, &d.infinite) == 1);
+  assert(infinite_state_machine_in(&ism.machine, &e.infinite) == 1);
+  assert(infinite_state_machine_in(&ism.machine, &f.infinite) == 1);
+  assert(infinite_state_machine_in(&ism.machine, &g.infinite) == 0);
+  infinite_state_machine_goto(&ism.machine, &g.infinite);
+  assert(infinite_state_machine_in(&ism.machine, &d.infinite) == 1);
+  assert(infinite_state_machine_in(&ism.machine, &e.infinite) == 0);
+  assert(infinite_state_machine_in(&ism.machine, &f.infinite) == 0);
+  assert(infinite_state_machine_in(&ism.machine, &g.infinite) == 1);
+
+  /*
+   * A machine too shallow for a state refuses to go there rather than
+   * dropping its outer states, including when an initial sub-state would
+   * overflow it.
+   */
+  assert(infinite_state_machine_init_depth(&shallow.machine, 0) == -EINVAL);
+  assert(infinite_state_machine_init_depth(
+             &shallow.machine, INFINITE_STATE_MACHINE_MAX_DEPTH + 1) == -EINVAL);
+  assert(infinite_state_machine_init_depth(&shallow.machine, 2) == 0);
+  assert(infinite_state_machine_goto(&shallow.machine, &g.infinite) == 0);
+  entered = exited = 0;
+  assert(infinite_state_machine_goto(&shallow.machine, &f.infinite) == -ENOMEM);
+  assert(infinite_state_machine_jump(&shallow.machine, &f.infinite) == -ENOMEM);
+  assert(infinite_state_machine_top(&shallow.machine) == &g.infinite);
+  assert(entered == 0 && exited == 0);
+  e.infinite.initial = &f.infinite;
+  assert(infinite_state_machine_goto(&shallow.machine, &e.infinite) == -ENOMEM);
+  assert(infinite_state_machine_top(&shallow.machine) == &g.infinite);
+  e.infinite.initial = NULL;
+  /*
+   * Transitioning by kind reports running out of depth too, having entered as
+   * far as the machine allows.
+   */
+  assert(infinite_state_machine_goto(&shallow.machine, &e.infinite) == 0);
+  assert(infinite_state_machine_transition(&shallow.machine, &d.infinite,
+                                           &f.infinite,
+                                           INFINITE_STATE_TRANSITION_LOCAL) ==
+         -ENOMEM);
+  assert(infinite_state_machine_top(&shallow.machine) == &e.infinite);
+
+  /*
+   * Transient states within a transaction neither enter nor exit. Going from
+   * g to e by way of f and d only exits g and enters e.
+   */
+  struct infinite_state_machine_transaction transaction;
+  entered = exited = 0;
+  infinite_state_machine_transaction_begin(&transaction, &ism.machine);
+  infinite_state_machine_transaction_goto(&transaction, &f.infinite);
+  infinite_state_machine_transaction_goto(&transaction, &d.infinite);
+  infinite_state_machine_transaction_goto(&transaction, &e.infinite);
+  assert(infinite_state_machine_top(&ism.machine) == &g.infinite);
+  assert(entered == 0 && exited == 0);
+  infinite_state_machine_transaction_commit(&transaction);
+  assert(infinite_state_machine_top(&ism.machine) == &e.infinite);
+  assert(infinite_state_machine_in(&ism.machine, &g.infinite) == 0);
+  assert(entered == 1 && exited == 1);
+
+  /*
+   * Transitions by kind from composite d, with e active within it. Internal
+   * runs nothing; local to f exits and re-enters only d's sub-states; external
+   * to f exits and re-enters d as well; local from d to itself exits only its
+   * sub-states. An inactive source
+   * fails.
+   */
+  entered = exited = 0;
+  assert(infinite_state_machine_transition(&ism.machine, &d.infinite, NULL,
+                                           INFINITE_STATE_TRANSITION_INTERNAL) == 0);
+  assert(entered == 0 && exited == 0);
+  assert(infinite_state_machine_transition(&ism.machine, &d.infinite, &f.infinite,
+                                           INFINITE_STATE_TRANSITION_LOCAL) == 0);
+  assert(infinite_state_machine_top(&ism.machine) == &f.infinite);
+  assert(entered == 2 && exited == 1);
+  entered = exited = 0;
+  assert(infinite_state_machine_transition(&ism.machine, &d.infinite, &f.infinite,
+                                           INFINITE_STATE_TRANSITION_EXTERNAL) == 0);
+  assert(infinite_state_machine_top(&ism.machine) == &f.infinite);
+  assert(entered == 3 && exited == 3);
+  entered = exited = 0;
+  assert(infinite_state_machine_transition(&ism.machine, &d.infinite, &d.infinite,
+                                           INFINITE_STATE_TRANSITION_LOCAL) == 0);
+  assert(infinite_state_machine_top(&ism.machine) == &d.infinite);
+  assert(entered == 0 && exited == 2);
+  assert(infinite_state_machine_transition(&ism.machine, &e.infinite, &f.infinite,
+                                           INFINITE_STATE_TRANSITION_LOCAL) == -EINVAL);
+  /*
+   * A target outside the source exits the source whatever the kind.
+   */
+  infinite_state_machine_goto(&ism.machine, &f.infinite);
+  entered = exited = 0;
+  assert(infinite_state_machine_transition(&ism.machine, &e.infinite, &g.infinite,
+                                           INFINITE_STATE_TRANSITION_LOCAL) == 0);
+  assert(infinite_state_machine_top(&ism.machine) == &g.infinite);
+  assert(entered == 1 && exited == 2);
+  infinite_state_machine_goto(&ism.machine, &e.infinite);
+
+  /*
+   * Going to d drills down through its initial sub-states to f. Going to g
+   * then completes straight back to e, and again to f, without recursion.
+   */
+  d.infinite.initial = &e.infinite;
+  e.infinite.initial = &f.infinite;
+  g.infinite.completion = &e.infinite;
+  infinite_state_machine_goto(&ism.machine, NULL);
+  entered = exited = 0;
+  infinite_state_machine_goto(&ism.machine, &d.infinite);
+  assert(infinite_state_machine_top(&ism.machine) == &f.infinite);
+  assert(entered == 3 && exited == 0);
+  entered = exited = 0;
+#ifdef INFINITE_STATE_COVERAGE
+  infinite_state_coverage_reset();
+#endif
+  infinite_state_machine_goto(&ism.machine, &g.infinite);
+  assert(infinite_state_machine_top(&ism.machine) == &f.infinite);
+  assert(entered == 3 && exited == 3);
+#ifdef INFINITE_STATE_COVERAGE
+  /*
+   * The completion from g to e covers its transition as any goto would.
+   */
+  assert(infinite_state_coverage_transitioned(&g.infinite, &e.infinite));
+#endif
+  entered = exited = 0;
+  assert(infinite_state_machine_transition(&ism.machine, &d.infinite, &d.infinite,
+                                           INFINITE_STATE_TRANSITION_LOCAL) == 0);
+  assert(infinite_state_machine_top(&ism.machine) == &f.infinite);
+  assert(entered == 2 && exited == 2);
+  infinite_state_machine_jump(&ism.machine, &d.infinite);
+  assert(infinite_state_machine_top(&ism.machine) == &f.infinite);
+  d.infinite.initial = e.infinite.initial = g.infinite.completion = NULL;
+  infinite_state_machine_goto(&ism.machine, &e.infinite);
+
+  /*
+   * State-local storage comes from the machine's arena, from outer to inner.
+   */
+  static union {
+    unsigned char bytes[4 * INFINITE_STATE_ALIGNMENT];
+    long double align;
+  } storage;
+  struct infinite_state_arena arena = {.base = storage.bytes,
+                                       .size = sizeof(storage.bytes)};
+  d.infinite.size = sizeof(int);
+  e.infinite.size = INFINITE_STATE_ALIGNMENT + 1;
+  f.infinite.size = sizeof(int);
+  assert(infinite_state_size(&f.infinite, INFINITE_STATE_MACHINE_MAX_DEPTH) ==
+         4 * INFINITE_STATE_ALIGNMENT);
+  infinite_state_machine_init(&ism.machine);
+  infinite_state_machine_arena(&ism.machine, &arena);
+  infinite_state_machine_goto(&ism.machine, &f.infinite);
+  assert(arena.used == 4 * INFINITE_STATE_ALIGNMENT);
+  assert(infinite_state_machine_data(&ism.machine, &d.infinite) == storage.bytes);
+  assert(infinite_state_machine_data(&ism.machine, &e.infinite) ==
+         storage.bytes + INFINITE_STATE_ALIGNMENT);
+  assert(infinite_state_machine_data(&ism.machine, &f.infinite) ==
+         storage.bytes + 3 * INFINITE_STATE_ALIGNMENT);
+  assert(infinite_state_machine_data(&ism.machine, &g.infinite) == NULL);
+  /*
+   * Exit actions still see their storage; e exits last.
+   */
+  infinite_state_machine_goto(&ism.machine, &g.infinite);
+  assert(exited_data == storage.bytes + INFINITE_STATE_ALIGNMENT);
+  assert(arena.used == INFINITE_STATE_ALIGNMENT);
+  assert(infinite_state_machine_data(&ism.machine, &g.infinite) == NULL);
+  /*
+   * Pushing fails when the arena runs out of storage.
+   */
+  infinite_state_machine_goto(&ism.machine, &d.infinite);
+  g.infinite.size = 4 * INFINITE_STATE_ALIGNMENT;
+  infinite_state_machine_goto(&ism.machine, &g.infinite);
+  assert(infinite_state_machine_in(&ism.machine, &g.infinite) == 0);
+  assert(arena.used == INFINITE_STATE_ALIGNMENT);
+  d.infinite.size = e.infinite.size = f.infinite.size = g.infinite.size = 0;
   return 0;
 }
 
-static void enter_action(struct infinite_state *state,
+static void enter_action(const struct infinite_state *state,
                          struct infinite_state_machine *machine) {
-  struct state *s = (struct state *)state;
+  const struct state *s = (const struct state *)state;
   assert(s->name != NULL);
   printf("enter %s\n", s->name);
+  entered++;
 }
 
-static void exit_action(struct infinite_state *state,
+static void exit_action(const struct infinite_state *state,
                         struct infinite_state_machine *machine) {
-  struct state *s = (struct state *)state;
+  const struct state *s = (const struct state *)state;
   assert(s->name != NULL);
   printf("exit %s\n", s->name);
+  exited_data = infinite_state_machine_data(machine, state);
+  exited++;
 }
@@ -0,0 +1,98 @@
+#include "infinite_state_defer.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stddef.h>
+
+struct event {
+  struct infinite_state_event infinite;
+  int signal;
+};
+
+/*
+ * Composite a holds b, which holds c; a also holds d.
+ */
+struct topology {
+  struct infinite_state a, b, c, d;
+};
+
+static const struct topology topology = {
+    .b.super = INFINITE_STATE_REF_OF(struct topology, topology, a),
+    .c.super = INFINITE_STATE_REF_OF(struct topology, topology, b),
+    .d.super = INFINITE_STATE_REF_OF(struct topology, topology, a)};
+static const struct infinite_state *const a = &topology.a,
+                                          *const b = &topology.b,
+                                          *const c = &topology.c,
+                                          *const d = &topology.d;
+
+static int take(struct infinite_state_queue *queue) {
+  struct event *event = (struct event *)infinite_state_queue_take(queue);
+  return event != NULL ? event->signal : 0;
+}
+
+int test_defer() {
+#if INFINITE_STATE_REF_BITS
+  infinite_state_base = &topology;
+#endif
+  static INFINITE_STATE_MACHINE(ism, 3);
+  struct infinite_state_queue queue;
+  struct infinite_state_deferral deferral;
+  struct event events[] = {{.signal = 1}, {.signal = 2}, {.signal = 3},
+                           {.signal = 4}, {.signal = 5}};
+  infinite_state_queue_init(&queue);
+  infinite_state_deferral_init(&deferral, &queue);
+  infinite_state_machine_init(&ism.machine);
+  assert(infinite_state_machine_defer(&ism.machine, a, &events[0].infinite) ==
+         -EINVAL);
+  infinite_state_machine_deferral(&ism.machine, &deferral);
+  infinite_state_machine_goto(&ism.machine, c);
+  assert(infinite_state_machine_defer(&ism.machine, d, &events[0].infinite) ==
+         -EINVAL);
+  /*
+   * Events 1 and 3 defer in c, 2 in b; 4 and 5 wait in the queue.
+   */
+  assert(infinite_state_machine_defer(&ism.machine, c, &events[0].infinite) ==
+         0);
+  assert(infinite_state_machine_defer(&ism.machine, b, &events[1].infinite) ==
+         0);
+  assert(infinite_state_machine_defer(&ism.machine, c, &events[2].infinite) ==
+         0);
+  infinite_state_queue_post(&queue, &events[3].infinite);
+  infinite_state_queue_post(&queue, &events[4].infinite);
+  /*
+   * Going to b exits c only, recalling 1 and 3 ahead of 4 and 5.
+   */
+  infinite_state_machine_goto(&ism.machine, b);
+  assert(take(&queue) == 1);
+  assert(take(&queue) == 3);
+  assert(take(&queue) == 4);
+  /*
+   * Going to d exits b, recalling 2 ahead of 5. An empty queue recalls to
+   * its tail.
+   */
+  infinite_state_machine_goto(&ism.machine, d);
+  assert(take(&queue) == 2);
+  assert(take(&queue) == 5);
+  assert(take(&queue) == 0);
+  assert(infinite_state_machine_defer(&ism.machine, a, &events[0].infinite) ==
+         0);
+  infinite_state_machine_goto(&ism.machine, NULL);
+  assert(take(&queue) == 1);
+  assert(take(&queue) == 0);
+  infinite_state_queue_post(&queue, &events[1].infinite);
+  assert(take(&queue) == 2);
+  /*
+   * Jumping recalls every level without running exit actions.
+   */
+  infinite_state_machine_goto(&ism.machine, c);
+  assert(infinite_state_machine_defer(&ism.machine, a, &events[0].infinite) ==
+         0);
+  assert(infinite_state_machine_defer(&ism.machine, c, &events[2].infinite) ==
+         0);
+  infinite_state_machine_jump(&ism.machine, d);
+  assert(ism.machine.deferral == &deferral);
+  assert(take(&queue) == 1);
+  assert(take(&queue) == 3);
+  assert(take(&queue) == 0);
+  return 0;
+}
@@ -0,0 +1,37 @@
+#include "infinite_state_machine.h"
+
+#include <cassert>
+
+#if !INFINITE_STATE_REF_BITS
+/*
+ * A constant-expression topology sizes its machine at compile time.
+ */
+static constexpr infinite_state outer{};
+static constexpr infinite_state inner{.super = &outer,
+                                      .enter = nullptr,
+                                      .exit = nullptr,
+                                      .size = 0,
+                                      .initial = nullptr,
+                                      .completion = nullptr};
+static constexpr infinite_state innermost{.super = &inner,
+                                          .enter = nullptr,
+                                          .exit = nullptr,
+                                          .size = 0,
+                                          .initial = nullptr,
+                                          .completion = nullptr};
+
+static_assert(infinite_state_constexpr_depth(&innermost) == 3);
+static_assert(infinite_state_constexpr_depth(nullptr) == 0);
+
+static INFINITE_STATE_MACHINE(ism, infinite_state_constexpr_depth(&innermost));
+#endif
+
+extern "C" int test_depth(int argc, char *argv[]) {
+#if !INFINITE_STATE_REF_BITS
+  static_assert(sizeof(ism) == INFINITE_STATE_MACHINE_SIZE(3));
+  infinite_state_machine_init(&ism.machine);
+  assert(infinite_state_machine_goto(&ism.machine, &innermost) == 0);
+  assert(ism.machine.depth == 3);
+#endif
+  return 0;
+}
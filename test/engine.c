@@ -7,9 +7,8 @@ static void engine_cycle(void);
 static void igniting_cycle(void);
 static void cranking_cycle(void);
 
-static void starting_enter(struct infinite_state *state, struct infinite_state_machine *machine);
-static void igniting_enter(struct infinite_state *state, struct infinite_state_machine *machine);
-static void cranking_enter(struct infinite_state *state, struct infinite_state_machine *machine);
+static void igniting_enter(const struct infinite_state *state, struct infinite_state_machine *machine);
+static void cranking_enter(const struct infinite_state *state, struct infinite_state_machine *machine);
 
 struct engine
 {
@@ -17,34 +16,58 @@ struct engine
     void (*cycle)(void);
 };
 
+/*
+ * Mutable data for the starting sub-states, held per machine in its arena.
+ */
 struct starting
 {
-    struct engine engine;
     int cycling;
 };
 
 /*
- * Initialise the engine state topology.
+ * Initialise the engine state topology. The topology is constant; it can
+ * live in read-only memory and many machines can share it. Starting enters
+ * igniting by default.
+ */
+static const struct engine igniting;
+static const struct engine stopped = {.cycle = engine_cycle};
+static const struct engine starting = {.state.initial = &igniting.state, .cycle = engine_cycle};
+static const struct engine igniting = {.state.super = &starting.state, .state.enter = igniting_enter, .state.size = sizeof(struct starting), .cycle = igniting_cycle};
+static const struct engine cranking = {.state.super = &starting.state, .state.enter = cranking_enter, .state.size = sizeof(struct starting), .cycle = cranking_cycle};
+static const struct engine running = {.cycle = engine_cycle};
+
+/*
+ * The engine topology nests at most two states deep.
  */
-static struct engine stopped = {.cycle = engine_cycle};
-static struct engine starting = {.state.enter = starting_enter, .cycle = engine_cycle};
-static struct starting igniting = {.engine = {.state.super = &starting.state, .state.enter = igniting_enter, .cycle = igniting_cycle}};
-static struct starting cranking = {.engine = {.state.super = &starting.state, .state.enter = cranking_enter, .cycle = cranking_cycle}};
-static struct engine running = {.cycle = engine_cycle};
+static INFINITE_STATE_MACHINE(engine, 2);
+
+static union
+{
+    unsigned char bytes[INFINITE_STATE_ALIGN(sizeof(struct starting))];
+    long double align;
+} storage;
 
-static struct infinite_state_machine engine;
+static struct infinite_state_arena arena = {.base = storage.bytes, .size = sizeof(storage.bytes)};
 
-static void go(struct engine *to)
+static void go(const struct engine *to)
 {
-    infinite_state_machine_goto(&engine, &to->state);
+    infinite_state_machine_goto(&engine.machine, &to->state);
 }
 
 /*
  * Check if the engine is in a specific state or super-state.
  */
-static bool in(struct engine *in)
+static bool in(const struct engine *in)
 {
-    return infinite_state_machine_in(&engine, &in->state) == 1;
+    return infinite_state_machine_in(&engine.machine, &in->state) == 1;
+}
+
+/*
+ * Access the mutable data of an active starting sub-state.
+ */
+static struct starting *data(const struct engine *state)
+{
+    return infinite_state_machine_data(&engine.machine, &state->state);
 }
 
 /*
@@ -77,7 +100,7 @@ void stop(void)
  */
 static void cycle(void)
 {
-    ((struct engine *)infinite_state_machine_top(&engine))->cycle();
+    ((const struct engine *)infinite_state_machine_top(&engine.machine))->cycle();
 }
 
 /*
@@ -91,7 +114,8 @@ int test_engine()
      * all static and global variables to zero. In other words, C has already initialised
      * the machine for us.
      */
-    infinite_state_machine_init(&engine);
+    infinite_state_machine_init(&engine.machine);
+    infinite_state_machine_arena(&engine.machine, &arena);
 
     /*
      * Set up the engine by applying the initial transition.
@@ -101,13 +125,13 @@ int test_engine()
     assert(in(&stopped));
     start();
     assert(in(&starting));
-    assert(in(&igniting.engine));
+    assert(in(&igniting));
     cycle();
     assert(in(&starting));
-    assert(in(&cranking.engine));
+    assert(in(&cranking));
     cycle();
     assert(in(&starting));
-    assert(in(&cranking.engine));
+    assert(in(&cranking));
     cycle();
     assert(in(&running));
     stop();
@@ -120,31 +144,26 @@ static void engine_cycle(void) {}
 
 static void igniting_cycle(void)
 {
-    if (--igniting.cycling == 0)
+    if (--data(&igniting)->cycling == 0)
     {
-        go(&cranking.engine);
+        go(&cranking);
     }
 }
 
 static void cranking_cycle(void)
 {
-    if (--cranking.cycling == 0)
+    if (--data(&cranking)->cycling == 0)
     {
         go(&running);
     }
 }
 
-static void starting_enter(struct infinite_state *state, struct infinite_state_machine *machine)
-{
-    go(&igniting.engine);
-}
-
-static void igniting_enter(struct infinite_state *state, struct infinite_state_machine *machine)
+static void igniting_enter(const struct infinite_state *state, struct infinite_state_machine *machine)
 {
-    igniting.cycling = 1;
+    data(&igniting)->cycling = 1;
 }
 
-static void cranking_enter(struct infinite_state *state, struct infinite_state_machine *machine)
+static void cranking_enter(const struct infinite_state *state, struct infinite_state_machine *machine)
 {
-    cranking.cycling = 2;
+    data(&cranking)->cycling = 2;
 }
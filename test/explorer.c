@@ -0,0 +1,120 @@
+#include "infinite_state_explorer.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stddef.h>
+
+/*
+ * Region 0 cycles b, c in a, then d; e is dead. Region 1 toggles x and y.
+ */
+struct topology {
+  struct infinite_state a, b, c, d, e, x, y;
+  struct infinite_state ring[40];
+};
+
+static struct topology topology = {
+    .b.super = INFINITE_STATE_REF_OF(struct topology, topology, a),
+    .c.super = INFINITE_STATE_REF_OF(struct topology, topology, a),
+};
+
+static const struct infinite_state *const states[] = {
+    &topology.a, &topology.b, &topology.c, &topology.d,
+    &topology.e, &topology.x, &topology.y};
+
+static const struct infinite_state_explorer_transition transitions[] = {
+    {0, &topology.b, &topology.c}, {0, &topology.c, &topology.d},
+    {0, &topology.d, &topology.b}, {1, &topology.x, &topology.y},
+    {1, &topology.y, &topology.x}};
+
+/*
+ * Four regions of ten-state rings: 10^4 configurations.
+ */
+static void explore_rings(int threads, struct infinite_state_exploration *exploration) {
+  static const struct infinite_state *ring[40];
+  static const struct infinite_state *initial[4];
+  static struct infinite_state_explorer_transition steps[40];
+  for (int i = 0; i < 40; i++) {
+    ring[i] = &topology.ring[i];
+    steps[i] = (struct infinite_state_explorer_transition){
+        i / 10, &topology.ring[i], &topology.ring[i / 10 * 10 + (i + 1) % 10]};
+  }
+  for (int region = 0; region < 4; region++)
+    initial[region] = &topology.ring[region * 10];
+  struct infinite_state_explorer explorer = {.states = ring,
+                                             .count = 40,
+                                             .depth = 1,
+                                             .regions = 4,
+                                             .initial = initial,
+                                             .transitions = steps,
+                                             .transitioned = 40,
+                                             .threads = threads,
+                                             .capacity = 10000};
+  assert(infinite_state_explore(&explorer, exploration) == 0);
+}
+
+int test_explorer() {
+#if INFINITE_STATE_REF_BITS
+  infinite_state_base = &topology;
+#endif
+  const struct infinite_state *initial[] = {&topology.b, &topology.x};
+  struct infinite_state_explorer explorer = {.states = states,
+                                             .count = 7,
+                                             .depth = 2,
+                                             .regions = 2,
+                                             .initial = initial,
+                                             .transitions = transitions,
+                                             .transitioned = 5,
+                                             .threads = 2,
+                                             .capacity = 6};
+  struct infinite_state_exploration exploration;
+  assert(infinite_state_explore(&explorer, &exploration) == 0);
+  assert(exploration.configurations == 6);
+  assert(exploration.transitions == 12);
+  for (int i = 0; i < 7; i++)
+    assert(exploration.reached[i] == (i != 4));
+  /*
+   * Configurations pack each region's stack: [a b] [x] is 1 2 6 0.
+   */
+  int found = 0;
+  for (size_t i = 0; i < exploration.configurations; i++) {
+    infinite_state_explorer_id *ids = exploration.ids + 4 * i;
+    found += ids[0] == 1 && ids[1] == 2 && ids[2] == 6 && ids[3] == 0;
+  }
+  assert(found == 1);
+  infinite_state_exploration_free(&exploration);
+  explorer.capacity = 5;
+  assert(infinite_state_explore(&explorer, &exploration) == -ENOSPC);
+  const struct infinite_state_explorer_transition invalid = {2, &topology.b,
+                                                             &topology.c};
+  explorer.transitions = &invalid;
+  explorer.transitioned = 1;
+  explorer.capacity = 6;
+  assert(infinite_state_explore(&explorer, &exploration) == -EINVAL);
+  /*
+   * Starting in a enters its initial sub-state b; going to c completes
+   * straight to d, so c never stays active.
+   */
+  topology.a.initial = INFINITE_STATE_REF_OF(struct topology, topology, b);
+  topology.c.completion = INFINITE_STATE_REF_OF(struct topology, topology, d);
+  initial[0] = &topology.a;
+  explorer.transitions = transitions;
+  explorer.transitioned = 5;
+  assert(infinite_state_explore(&explorer, &exploration) == 0);
+  assert(exploration.configurations == 4);
+  assert(exploration.transitions == 8);
+  assert(!exploration.reached[2]);
+  infinite_state_exploration_free(&exploration);
+  topology.a.initial = topology.c.completion = INFINITE_STATE_REF(NULL);
+
+  /*
+   * One thread or four, the same results.
+   */
+  struct infinite_state_exploration one, four;
+  explore_rings(1, &one);
+  explore_rings(4, &four);
+  assert(one.configurations == 10000 && four.configurations == 10000);
+  assert(one.transitions == 40000 && four.transitions == 40000);
+  infinite_state_exploration_free(&one);
+  infinite_state_exploration_free(&four);
+  return 0;
+}
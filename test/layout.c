@@ -0,0 +1,68 @@
+#include "infinite_state_layout.h"
+#include "infinite_state_machine.h"
+
+#include <assert.h>
+#include <stddef.h>
+
+struct state {
+  struct infinite_state infinite;
+  const char *name;
+};
+
+/*
+ * A topology arena, including the laid-out copies, so that compressed
+ * references can address all the states.
+ */
+struct topology {
+  struct state a, b, c, d, e;
+  struct state arena[5];
+};
+
+static struct topology topology = {
+    .a.name = "a",
+    .b = {.name = "b",
+          .infinite.super =
+              INFINITE_STATE_REF_OF(struct topology, topology, a.infinite)},
+};
+
+int test_layout() {
+#if INFINITE_STATE_REF_BITS
+  infinite_state_base = &topology;
+#endif
+  struct state *arena = topology.arena;
+  /*
+   * Complete the topology at run time: c in b in a, d in a, e alone.
+   */
+  topology.c.infinite.super = INFINITE_STATE_REF(&topology.b.infinite);
+  topology.d.infinite.super = INFINITE_STATE_REF(&topology.a.infinite);
+  topology.c.name = "c";
+  topology.d.name = "d";
+  topology.e.name = "e";
+  const struct infinite_state *const states[] = {
+      &topology.a.infinite, &topology.b.infinite, &topology.c.infinite,
+      &topology.d.infinite, &topology.e.infinite};
+  /*
+   * Transitions between d and e dominate; c sees a few.
+   */
+  const struct infinite_state_counter counters[] = {
+      {.from = &topology.d.infinite, .to = &topology.e.infinite, .count = 100},
+      {.from = &topology.e.infinite, .to = &topology.d.infinite, .count = 99},
+      {.from = NULL, .to = &topology.c.infinite, .count = 3}};
+  const struct infinite_state *relocated[5];
+  assert(infinite_state_layout(states, 5, sizeof(struct state), counters, 3,
+                               arena, relocated) == 0);
+  /*
+   * Hottest first: d after its super-state a, then e, then c after b.
+   */
+  assert(relocated[0] == &arena[0].infinite);
+  assert(relocated[3] == &arena[1].infinite);
+  assert(relocated[4] == &arena[2].infinite);
+  assert(relocated[1] == &arena[3].infinite);
+  assert(relocated[2] == &arena[4].infinite);
+  assert(INFINITE_STATE_DEREF(arena[1].infinite.super) == &arena[0].infinite);
+  assert(INFINITE_STATE_DEREF(arena[4].infinite.super) == &arena[3].infinite);
+  assert(INFINITE_STATE_DEREF(arena[3].infinite.super) == &arena[0].infinite);
+  assert(arena[2].infinite.super == INFINITE_STATE_REF(NULL));
+  assert(((const struct state *)relocated[2])->name[0] == 'c');
+  return 0;
+}
@@ -0,0 +1,91 @@
+#include "infinite_state_mailbox.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <signal.h>
+
+static void enter_action(const struct infinite_state *state,
+                         struct infinite_state_machine *machine);
+
+/*
+ * Composite a holds b and c; d stands alone.
+ */
+struct topology {
+  struct infinite_state a, b, c, d;
+};
+
+static struct topology topology = {
+    .a.enter = enter_action,
+    .b.super = INFINITE_STATE_REF_OF(struct topology, topology, a),
+    .b.enter = enter_action,
+    .c.super = INFINITE_STATE_REF_OF(struct topology, topology, a),
+    .c.enter = enter_action,
+    .d.enter = enter_action,
+};
+
+static INFINITE_STATE_MACHINE(ism, 2);
+
+static struct infinite_state_mailbox_slot slots[4];
+
+static struct infinite_state_mailbox mailbox;
+
+static int entered, dispatched, posted;
+
+static void enter_action(const struct infinite_state *state,
+                         struct infinite_state_machine *machine) {
+  entered++;
+}
+
+static void handler(int signal) {
+  posted = infinite_state_mailbox_post(&mailbox, &topology.b, &posted);
+}
+
+static void dispatch(struct infinite_state_machine *machine,
+                     const struct infinite_state *state, void *data,
+                     void *context) {
+  infinite_state_machine_goto(machine, state);
+  /*
+   * Posting while draining lands in the same batch.
+   */
+  if (data == context)
+    assert(infinite_state_mailbox_post(&mailbox, &topology.d, NULL) == 0);
+  dispatched++;
+}
+
+int test_mailbox() {
+#if INFINITE_STATE_REF_BITS
+  infinite_state_base = &topology;
+#endif
+  infinite_state_machine_init(&ism.machine);
+  assert(infinite_state_mailbox_init(&mailbox, &ism.machine, slots, 3) ==
+         -EINVAL);
+  assert(infinite_state_mailbox_init(&mailbox, &ism.machine, slots, 4) == 0);
+  assert(infinite_state_mailbox_drain(&mailbox, 8, NULL, NULL) == 0);
+  /*
+   * A signal handler posts b; then c and d follow. A burst of three goes
+   * straight to d, entering nothing else.
+   */
+  signal(SIGTERM, handler);
+  assert(raise(SIGTERM) == 0);
+  signal(SIGTERM, SIG_DFL);
+  assert(posted == 0);
+  assert(infinite_state_mailbox_post(&mailbox, &topology.c, NULL) == 0);
+  assert(infinite_state_mailbox_post(&mailbox, &topology.d, NULL) == 0);
+  assert(infinite_state_mailbox_drain(&mailbox, 8, NULL, NULL) == 3);
+  assert(infinite_state_machine_top(&ism.machine) == &topology.d);
+  assert(entered == 1);
+  /*
+   * Four fit, five do not. Dispatching drains in batches, one event at a
+   * time, and wraps around the ring.
+   */
+  for (int post = 0; post < 4; post++)
+    assert(infinite_state_mailbox_post(&mailbox, &topology.b,
+                                       post == 3 ? &posted : NULL) == 0);
+  assert(infinite_state_mailbox_post(&mailbox, &topology.c, NULL) == -EAGAIN);
+  assert(infinite_state_mailbox_drain(&mailbox, 2, dispatch, &posted) == 2);
+  assert(infinite_state_mailbox_drain(&mailbox, 8, dispatch, &posted) == 3);
+  assert(dispatched == 5);
+  assert(infinite_state_machine_top(&ism.machine) == &topology.d);
+  assert(infinite_state_mailbox_drain(&mailbox, 8, dispatch, &posted) == 0);
+  return 0;
+}
@@ -0,0 +1,174 @@
+#include "infinite_state_machine.hpp"
+#include "infinite_state_pool.hpp"
+
+#include <cassert>
+#include <cerrno>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+struct frame {
+  int sequence = -1;
+  unsigned char bytes[60];
+};
+
+/*
+ * Small events for counters, larger ones for frames.
+ */
+static const infinite_state_pool_class classes[] = {{sizeof(int), 256},
+                                                    {sizeof(frame), 2}};
+
+alignas(std::max_align_t) static unsigned char storage[16384];
+
+static infinite_state_pool pool;
+
+/*
+ * The C engine's machines each have a mailbox.
+ */
+struct topology {
+  infinite_state idle, busy;
+};
+
+static topology topology;
+
+static INFINITE_STATE_MACHINE(first_machine, 1);
+static INFINITE_STATE_MACHINE(second_machine, 1);
+static INFINITE_STATE_MACHINE(third_machine, 1);
+
+static infinite_state_machine *machines[] = {&first_machine.machine,
+                                             &second_machine.machine,
+                                             &third_machine.machine};
+
+static infinite_state_mailbox_slot slots[3][4];
+
+static infinite_state_mailbox mailboxes[3];
+
+static const frame *seen[3];
+
+static void handler(infinite_state_machine *machine,
+                    const infinite_state *state,
+                    infinite_state_pool_event *event, void *context) {
+  infinite_state_machine_goto(machine, state);
+  auto payload = static_cast<const frame *>(infinite_state_pool_payload(event));
+  assert(payload->sequence == 1);
+  *static_cast<const frame **>(context) = payload;
+}
+
+/*
+ * The C++ engine's machines keep the frame while busy.
+ */
+struct cpp_state : infinite::state<cpp_state> {};
+
+static cpp_state idle = {nullptr};
+static cpp_state busy = {nullptr};
+
+extern "C" int test_pool(int argc, char *argv[]) {
+#if INFINITE_STATE_REF_BITS
+  infinite_state_base = &topology;
+#endif
+  static const infinite_state_pool_class descending[] = {{64, 1}, {16, 1}};
+  assert(infinite_state_pool_init(&pool, descending, 2, storage,
+                                  sizeof(storage)) == -EINVAL);
+  assert(infinite_state_pool_size(classes, 2) <= sizeof(storage));
+  assert(infinite_state_pool_init(&pool, classes, 2, storage, 16) == -EINVAL);
+  assert(infinite_state_pool_init(&pool, classes, 2, storage,
+                                  sizeof(storage)) == 0);
+
+  /*
+   * Frames come from the larger class, until it runs out; nothing fits a
+   * payload larger than the largest class.
+   */
+  assert(infinite_state_pool_alloc(&pool, sizeof(frame) + 1) == nullptr);
+  infinite::pooled<frame> first(&pool), second(&pool), third(&pool);
+  assert(first && second && !third);
+  assert(first->sequence == -1 && second->bytes[0] == 0);
+  second = {};
+
+  /*
+   * One frame fans out to three C machines without copying. The frame lives
+   * until the last handler completes, then returns to the pool.
+   */
+  first->sequence = 1;
+  infinite_state_mailbox *posts[3];
+  for (int index = 0; index < 3; index++) {
+    infinite_state_machine_init(machines[index]);
+    assert(infinite_state_mailbox_init(&mailboxes[index], machines[index],
+                                       slots[index], 4) == 0);
+    posts[index] = &mailboxes[index];
+  }
+  assert(infinite_state_pool_post(posts, 3, &topology.busy,
+                                  first.handle()) == 3);
+  const frame *payload = first.get();
+  first = {};
+  for (int index = 0; index < 3; index++) {
+    if (index == 2) {
+      infinite::pooled<frame> spare(&pool), none(&pool);
+      assert(spare && !none);
+    }
+    assert(infinite_state_pool_drain(&mailboxes[index], 8, handler,
+                                     &seen[index]) == 1);
+    assert(seen[index] == payload);
+    assert(infinite_state_machine_top(machines[index]) == &topology.busy);
+  }
+  infinite::pooled<frame> reused(&pool);
+  assert(reused.get() == payload);
+  reused = {};
+
+  /*
+   * The same for C++ machines, each holding its own handle.
+   */
+  infinite::state_machine<cpp_state> ism[3];
+  std::vector<infinite::pooled<frame>> holding;
+  {
+    infinite::pooled<frame> shared(&pool);
+    shared->sequence = 2;
+    for (auto &machine : ism) {
+      machine.go(&busy);
+      holding.push_back(shared);
+    }
+  }
+  for (auto &held : holding)
+    assert(held->sequence == 2 && held.get() == holding.front().get());
+  infinite::pooled<frame> extra(&pool);
+  assert(extra);
+  for (auto &machine : ism) {
+    machine.go(&idle);
+    holding.pop_back();
+  }
+  infinite::pooled<frame> last(&pool);
+  assert(last);
+  extra = {};
+  last = {};
+
+  /*
+   * Threads allocate and release through their own caches, including events
+   * allocated elsewhere. Exiting threads return their caches, so that every
+   * event is free again afterwards.
+   */
+  std::vector<infinite::pooled<int>> handed;
+  for (int index = 0; index < 4; index++)
+    handed.emplace_back(&pool);
+  std::vector<std::thread> threads;
+  for (int index = 0; index < 4; index++)
+    threads.emplace_back([counter = std::move(handed[index])]() {
+      for (int loop = 0; loop < 10000; loop++) {
+        infinite::pooled<int> count(&pool);
+        assert(count);
+        *count = loop;
+        infinite::pooled<int> copy = count;
+        assert(*copy == loop);
+      }
+      (void)counter;
+    });
+  for (auto &thread : threads)
+    thread.join();
+  std::vector<infinite::pooled<int>> all;
+  for (int index = 0; index < 256; index++) {
+    all.emplace_back(&pool);
+    assert(all.back());
+  }
+  assert(!infinite::pooled<int>(&pool));
+  all.clear();
+  infinite_state_pool_destroy(&pool);
+  return 0;
+}
@@ -0,0 +1,78 @@
+#include "infinite_state_profile.h"
+
+#include <assert.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+struct state {
+  struct infinite_state infinite;
+  const char *name;
+};
+
+static void busy_enter(const struct infinite_state *state,
+                       struct infinite_state_machine *machine);
+
+/*
+ * One topology object, so that compressed references can address its states.
+ */
+struct topology {
+  struct state outer, busy;
+};
+
+static const struct topology topology = {
+    .outer = {.name = "outer"},
+    .busy = {.name = "busy",
+             .infinite.super =
+                 INFINITE_STATE_REF_OF(struct topology, topology,
+                                       outer.infinite),
+             .infinite.enter = busy_enter}};
+
+static INFINITE_STATE_MACHINE(ism, 2);
+
+static const char *name(const struct infinite_state *state) {
+  return ((const struct state *)state)->name;
+}
+
+static void ignore(int signal) { (void)signal; }
+
+int test_profile() {
+#if INFINITE_STATE_REF_BITS
+  infinite_state_base = &topology;
+#endif
+  /*
+   * Stopping restores whatever handled SIGPROF before starting.
+   */
+  struct sigaction action = {.sa_handler = ignore};
+  assert(sigaction(SIGPROF, &action, NULL) == 0);
+  infinite_state_profile_reset();
+  assert(infinite_state_profile_start(1000) == 0);
+  infinite_state_machine_goto(&ism.machine, &topology.busy.infinite);
+  infinite_state_profile_stop();
+  assert(infinite_state_profile_machine == NULL);
+  assert(sigaction(SIGPROF, NULL, &action) == 0);
+  assert(action.sa_handler == ignore);
+  char folded[256];
+  FILE *file = fmemopen(folded, sizeof(folded), "w");
+  assert(infinite_state_profile_dump(file, name) >= 1);
+  fclose(file);
+  printf("%s", folded);
+  /*
+   * Paths dump in table order, not by count; find the busy path's line.
+   */
+  const char *line = strstr(folded, "outer;busy ");
+  assert(line != NULL && (line == folded || line[-1] == '\n'));
+  return 0;
+}
+
+/*
+ * Burn some CPU time within the busy state's enter action; the goto publishes
+ * the machine meanwhile.
+ */
+static void busy_enter(const struct infinite_state *state,
+                       struct infinite_state_machine *machine) {
+  clock_t start = clock();
+  while (clock() - start < CLOCKS_PER_SEC / 10)
+    ;
+}
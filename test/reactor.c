@@ -0,0 +1,168 @@
+#include "infinite_state_reactor.h"
+
+#include <arpa/inet.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/*
+ * One topology object, so that compressed references can address its states.
+ */
+static const struct topology {
+  struct infinite_state connected, closed;
+} topology;
+
+/*
+ * A session embeds its source and machine; the reactor allocates nothing.
+ */
+struct session {
+  struct infinite_state_reactor_source source;
+  INFINITE_STATE_MACHINE_TYPE(1) ism;
+  struct infinite_state_reactor *reactor;
+  int bytes;
+};
+
+static void session_dispatch(struct infinite_state_reactor_source *source,
+                             unsigned events) {
+  struct session *session = (struct session *)source;
+  char buffer[64];
+  ssize_t bytes;
+  while ((bytes = read(source->fd, buffer, sizeof(buffer))) > 0)
+    session->bytes += bytes;
+  if (bytes == 0 || (events & INFINITE_STATE_REACTOR_HANGUP)) {
+    infinite_state_machine_goto(source->machine, &topology.closed);
+    assert(infinite_state_reactor_remove(session->reactor, source) == 0);
+  }
+}
+
+static void session_open(struct session *session,
+                         struct infinite_state_reactor *reactor, int fd) {
+  fcntl(fd, F_SETFL, O_NONBLOCK);
+  session->source.fd = fd;
+  session->source.machine = &session->ism.machine;
+  session->source.dispatch = session_dispatch;
+  assert(infinite_state_machine_init_depth(&session->ism.machine, 1) == 0);
+  infinite_state_machine_goto(&session->ism.machine, &topology.connected);
+  session->reactor = reactor;
+  session->bytes = 0;
+  assert(infinite_state_reactor_add(reactor, &session->source,
+                                    INFINITE_STATE_REACTOR_READ) == 0);
+}
+
+/*
+ * Each of two racing sources removes the other; only one dispatches.
+ */
+static struct infinite_state_reactor_source *racing[2];
+static int raced;
+
+static void race_dispatch(struct infinite_state_reactor_source *source,
+                          unsigned events) {
+  struct session *session = (struct session *)source;
+  assert(events & INFINITE_STATE_REACTOR_READ);
+  raced++;
+  struct infinite_state_reactor_source *other =
+      racing[0] == source ? racing[1] : racing[0];
+  assert(infinite_state_reactor_remove(session->reactor, other) == 0);
+  assert(infinite_state_reactor_remove(session->reactor, source) == 0);
+}
+
+/*
+ * Accepts one loopback connection into a session, stopping the reactor once
+ * the session closes.
+ */
+static struct session accepted;
+
+static void accepted_dispatch(struct infinite_state_reactor_source *source,
+                              unsigned events) {
+  session_dispatch(source, events);
+  if (infinite_state_machine_top(source->machine) == &topology.closed)
+    infinite_state_reactor_stop(accepted.reactor);
+}
+
+static void listener_dispatch(struct infinite_state_reactor_source *source,
+                              unsigned events) {
+  int fd = accept(source->fd, NULL, NULL);
+  assert(fd >= 0);
+  session_open(&accepted, accepted.reactor, fd);
+  accepted.source.dispatch = accepted_dispatch;
+}
+
+int test_reactor() {
+#if INFINITE_STATE_REF_BITS
+  infinite_state_base = &topology;
+#endif
+  struct infinite_state_reactor reactor;
+  assert(infinite_state_reactor_init(&reactor) == 0);
+  assert(infinite_state_reactor_poll(&reactor, 0) == 0);
+
+  /*
+   * Socket pair: data, then a hang-up.
+   */
+  int pair[2];
+  assert(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == 0);
+  struct session session;
+  session_open(&session, &reactor, pair[1]);
+  assert(write(pair[0], "hello", 5) == 5);
+  assert(infinite_state_reactor_poll(&reactor, 1000) == 1);
+  assert(session.bytes == 5);
+  assert(infinite_state_machine_top(&session.ism.machine) ==
+         &topology.connected);
+  close(pair[0]);
+  assert(infinite_state_reactor_poll(&reactor, 1000) == 1);
+  assert(infinite_state_machine_top(&session.ism.machine) == &topology.closed);
+  assert(infinite_state_reactor_poll(&reactor, 0) == 0);
+  close(pair[1]);
+
+  /*
+   * Two sources ready in one batch.
+   */
+  int pairs[2][2];
+  struct session races[2];
+  for (int i = 0; i < 2; i++) {
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, pairs[i]) == 0);
+    session_open(races + i, &reactor, pairs[i][1]);
+    races[i].source.dispatch = race_dispatch;
+    racing[i] = &races[i].source;
+    assert(write(pairs[i][0], "x", 1) == 1);
+  }
+  assert(infinite_state_reactor_poll(&reactor, 1000) == 1);
+  assert(raced == 1);
+  for (int i = 0; i < 2; i++) {
+    close(pairs[i][0]);
+    close(pairs[i][1]);
+  }
+
+  /*
+   * Loopback: accept, receive, hang up, stop.
+   */
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  assert(listener >= 0);
+  struct sockaddr_in address = {.sin_family = AF_INET,
+                                .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+  socklen_t length = sizeof(address);
+  assert(bind(listener, (struct sockaddr *)&address, sizeof(address)) == 0);
+  assert(getsockname(listener, (struct sockaddr *)&address, &length) == 0);
+  assert(listen(listener, 1) == 0);
+  struct infinite_state_reactor_source listening = {
+      .fd = listener, .dispatch = listener_dispatch};
+  accepted.reactor = &reactor;
+  assert(infinite_state_reactor_add(&reactor, &listening,
+                                    INFINITE_STATE_REACTOR_READ) == 0);
+  int client = socket(AF_INET, SOCK_STREAM, 0);
+  assert(connect(client, (struct sockaddr *)&address, sizeof(address)) == 0);
+  assert(write(client, "hello, world", 12) == 12);
+  close(client);
+  assert(infinite_state_reactor_run(&reactor) == 0);
+  assert(accepted.bytes == 12);
+  assert(infinite_state_machine_top(&accepted.ism.machine) == &topology.closed);
+  close(accepted.source.fd);
+  assert(infinite_state_reactor_remove(&reactor, &listening) == 0);
+  close(listener);
+
+  assert(infinite_state_reactor_pin(-1) == -EINVAL);
+  infinite_state_reactor_close(&reactor);
+  return 0;
+}
@@ -0,0 +1,131 @@
+#include "infinite_state_machine.h"
+#include "infinite_state_wcet.h"
+#ifdef INFINITE_STATE_COVERAGE
+#include "infinite_state_coverage.h"
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+
+static void b_enter(const struct infinite_state *state,
+                    struct infinite_state_machine *machine);
+static void e_enter(const struct infinite_state *state,
+                    struct infinite_state_machine *machine);
+static void e_exit(const struct infinite_state *state,
+                   struct infinite_state_machine *machine);
+
+/*
+ * Composite a holds b and c; d and e stand alone. Entering b goes to c;
+ * exiting e goes to d.
+ */
+struct topology {
+  struct infinite_state a, b, c, d, e;
+};
+
+static struct topology topology = {
+    .b.super = INFINITE_STATE_REF_OF(struct topology, topology, a),
+    .b.enter = b_enter,
+    .c.super = INFINITE_STATE_REF_OF(struct topology, topology, a),
+    .e.enter = e_enter,
+    .e.exit = e_exit,
+};
+
+static INFINITE_STATE_MACHINE(ism, 2);
+
+static int entered;
+
+static void b_enter(const struct infinite_state *state,
+                    struct infinite_state_machine *machine) {
+  /*
+   * Neither goto, committing a transaction nor transitioning by kind
+   * reenters; b remains the top state throughout its enter action.
+   */
+  struct infinite_state_machine_transaction transaction;
+  infinite_state_machine_transaction_begin(&transaction, machine);
+  infinite_state_machine_transaction_goto(&transaction, &topology.d);
+  infinite_state_machine_transaction_commit(&transaction);
+  infinite_state_machine_goto(machine, &topology.c);
+  assert(infinite_state_machine_transition(machine, &topology.a, &topology.c,
+                                           INFINITE_STATE_TRANSITION_LOCAL) ==
+         -EBUSY);
+  assert(infinite_state_machine_top(machine) == state);
+  entered++;
+}
+
+static int e_entered;
+
+static void e_enter(const struct infinite_state *state,
+                    struct infinite_state_machine *machine) {
+  e_entered++;
+}
+
+static void e_exit(const struct infinite_state *state,
+                   struct infinite_state_machine *machine) {
+  infinite_state_machine_goto(machine, &topology.d);
+}
+
+int test_realtime() {
+#if INFINITE_STATE_REF_BITS
+  infinite_state_base = &topology;
+#endif
+  infinite_state_machine_init(&ism.machine);
+#ifdef INFINITE_STATE_COVERAGE
+  infinite_state_coverage_reset();
+#endif
+  infinite_state_machine_goto(&ism.machine, &topology.b);
+  assert(entered == 1);
+  assert(infinite_state_machine_top(&ism.machine) == &topology.c);
+  assert(ism.machine.transaction == NULL);
+#ifdef INFINITE_STATE_COVERAGE
+  /*
+   * The request by b's enter action covers its transition from b to c.
+   */
+  assert(infinite_state_coverage_transitioned(&topology.b, &topology.c));
+#endif
+  infinite_state_machine_goto(&ism.machine, &topology.d);
+  assert(infinite_state_machine_transition(&ism.machine, &topology.d,
+                                           &topology.b,
+                                           INFINITE_STATE_TRANSITION_EXTERNAL) ==
+         0);
+  assert(entered == 2);
+  assert(infinite_state_machine_top(&ism.machine) == &topology.c);
+  /*
+   * Re-entering e externally stops once its exit action requests d; e never
+   * re-enters only to exit again.
+   */
+  infinite_state_machine_goto(&ism.machine, &topology.e);
+  assert(e_entered == 1);
+  assert(infinite_state_machine_transition(&ism.machine, &topology.e,
+                                           &topology.e,
+                                           INFINITE_STATE_TRANSITION_EXTERNAL) ==
+         0);
+  assert(e_entered == 1);
+  assert(infinite_state_machine_top(&ism.machine) == &topology.d);
+
+  /*
+   * Going to b exits and enters at most three states: from d, exit d then
+   * enter a and b. Its enter action's request for c costs a second pass and
+   * two more steps, which the analysis leaves out.
+   */
+  const struct infinite_state *const states[] = {&topology.a, &topology.b,
+                                                 &topology.c, &topology.d};
+  struct infinite_state_wcet wcet;
+  assert(infinite_state_wcet(states, 4, 2, &topology.b, &wcet) == 3);
+  assert(wcet.exits == 1 && wcet.enters == 2 && wcet.passes == 1);
+  assert(infinite_state_wcet(states, 4, 2, NULL, &wcet) == 2);
+  assert(wcet.exits == 2 && wcet.enters == 0);
+  /*
+   * Completing c to d adds a pass: from d, three steps to c and three back.
+   * Completing d back to c never ends.
+   */
+  topology.c.completion = INFINITE_STATE_REF_OF(struct topology, topology, d);
+  assert(infinite_state_wcet(states, 4, 2, &topology.c, &wcet) == 6);
+  assert(wcet.passes == 2);
+  topology.d.completion = INFINITE_STATE_REF_OF(struct topology, topology, c);
+  assert(infinite_state_wcet(states, 4, 2, &topology.c, &wcet) == -ELOOP);
+  assert(infinite_state_wcet_report(stdout, states, 4, 2, NULL) == -ELOOP);
+  topology.c.completion = topology.d.completion = INFINITE_STATE_REF(NULL);
+  assert(infinite_state_wcet_report(stdout, states, 4, 2, NULL) == 3);
+  return 0;
+}
@@ -0,0 +1,47 @@
+#include "infinite_state_machine.h"
+
+#include <assert.h>
+#include <stddef.h>
+
+/*
+ * A topology arena: all the states as members of one object, so that
+ * compressed references can address them by offset.
+ */
+struct topology {
+  struct infinite_state a, b, c, d;
+};
+
+static const struct topology topology = {
+    .b.super = INFINITE_STATE_REF_OF(struct topology, topology, a),
+    .c.super = INFINITE_STATE_REF_OF(struct topology, topology, b),
+    .d.super = INFINITE_STATE_REF_OF(struct topology, topology, a)};
+
+static INFINITE_STATE_MACHINE(ism, 3);
+
+int test_ref() {
+#if INFINITE_STATE_REF_BITS
+  infinite_state_base = &topology;
+  assert(sizeof(ism.machine.states[0]) * 8 == INFINITE_STATE_REF_BITS);
+#endif
+  assert(infinite_state_depth(&topology.c, INFINITE_STATE_MACHINE_MAX_DEPTH) == 3);
+  infinite_state_machine_init(&ism.machine);
+  infinite_state_machine_goto(&ism.machine, &topology.c);
+  assert(infinite_state_machine_top(&ism.machine) == &topology.c);
+  assert(infinite_state_machine_in(&ism.machine, &topology.a) == 1);
+  assert(infinite_state_machine_in(&ism.machine, &topology.b) == 1);
+  infinite_state_machine_goto(&ism.machine, &topology.d);
+  assert(infinite_state_machine_top(&ism.machine) == &topology.d);
+  assert(infinite_state_machine_in(&ism.machine, &topology.a) == 1);
+  assert(infinite_state_machine_in(&ism.machine, &topology.b) == 0);
+  assert(ism.machine.depth == 2);
+  /*
+   * Popping through goto decrements the depth once per exited state.
+   */
+  infinite_state_machine_goto(&ism.machine, &topology.c);
+  assert(ism.machine.depth == 3);
+  infinite_state_machine_goto(&ism.machine, &topology.a);
+  assert(ism.machine.depth == 1);
+  assert(infinite_state_machine_top(&ism.machine) == &topology.a);
+  assert(infinite_state_machine_in(&ism.machine, &topology.b) == 0);
+  return 0;
+}
@@ -0,0 +1,145 @@
+#include "infinite_state_simulator.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+
+static void igniting_enter(const struct infinite_state *state,
+                           struct infinite_state_machine *machine);
+static void cranking_enter(const struct infinite_state *state,
+                           struct infinite_state_machine *machine);
+
+static const struct infinite_state stopped, starting, running;
+static const struct infinite_state igniting = {.super = &starting,
+                                               .enter = igniting_enter};
+static const struct infinite_state cranking = {.super = &starting,
+                                               .enter = cranking_enter};
+
+static struct infinite_state_simulator simulator;
+
+/*
+ * Log of (machine, time) for each arrival at running.
+ */
+struct arrival {
+  struct infinite_state_machine *machine;
+  uint64_t time;
+};
+
+static struct arrival log[8];
+static int logged;
+
+static void go(struct infinite_state_simulator *simulator,
+               const struct infinite_state_simulator_event *event) {
+  infinite_state_machine_goto(event->machine, event->context);
+  if (event->context == &running && logged < 8) {
+    log[logged].machine = event->machine;
+    log[logged].time = simulator->now;
+    logged++;
+  }
+}
+
+/*
+ * Ignite for 2 ticks, then crank for 5 before running.
+ */
+static void igniting_enter(const struct infinite_state *state,
+                           struct infinite_state_machine *machine) {
+  infinite_state_simulator_schedule(&simulator, 2, machine, state, go,
+                                    (void *)&cranking);
+}
+
+static void cranking_enter(const struct infinite_state *state,
+                           struct infinite_state_machine *machine) {
+  infinite_state_simulator_schedule(&simulator, 5, machine, state, go,
+                                    (void *)&running);
+}
+
+static INFINITE_STATE_MACHINE(first, 2);
+static INFINITE_STATE_MACHINE(second, 2);
+static INFINITE_STATE_MACHINE(third, 2);
+
+static void simulate(void) {
+  static struct infinite_state_simulator_event events[16];
+  infinite_state_simulator_init(&simulator, events, 16);
+  struct infinite_state_machine *machines[] = {&first.machine, &second.machine,
+                                               &third.machine};
+  for (int i = 0; i < 3; i++) {
+    infinite_state_machine_init(machines[i]);
+    infinite_state_machine_goto(machines[i], &stopped);
+    /*
+     * Stagger the starts; all three start, but the third stops while
+     * cranking, so its cranking timeout expires unfired.
+     */
+    assert(infinite_state_simulator_schedule(&simulator, 10 * i, machines[i],
+                                             NULL, go,
+                                             (void *)&igniting) >= 0);
+  }
+  infinite_state_simulator_schedule(&simulator, 24, &third.machine, NULL, go,
+                                    (void *)&stopped);
+  logged = 0;
+}
+
+int test_simulator() {
+  simulate();
+  /*
+   * Nothing due before time 0 is skipped; the clock jumps through idle time.
+   */
+  assert(infinite_state_simulator_run(&simulator, 6) == 2);
+  assert(simulator.now == 6);
+  assert(infinite_state_machine_top(&first.machine) == &cranking);
+  assert(infinite_state_simulator_run(&simulator, 1000) == 7);
+  assert(simulator.now == 1000);
+  assert(infinite_state_simulator_step(&simulator) == -ENOENT);
+  assert(logged == 2);
+  assert(log[0].machine == &first.machine && log[0].time == 7);
+  assert(log[1].machine == &second.machine && log[1].time == 17);
+  assert(infinite_state_machine_top(&first.machine) == &running);
+  assert(infinite_state_machine_top(&second.machine) == &running);
+  assert(infinite_state_machine_top(&third.machine) == &stopped);
+  /*
+   * Running again reproduces the same history.
+   */
+  struct arrival history[8];
+  memcpy(history, log, sizeof(log));
+  simulate();
+  infinite_state_simulator_run(&simulator, 1000);
+  assert(logged == 2 && memcmp(history, log, sizeof(log)) == 0);
+  /*
+   * Events at the same time fire in the order scheduled; a full queue
+   * refuses more.
+   */
+  struct infinite_state_simulator_event events[2];
+  infinite_state_simulator_init(&simulator, events, 2);
+  assert(infinite_state_simulator_schedule(&simulator, 1, &first.machine, NULL,
+                                           go, (void *)&stopped) == 0);
+  assert(infinite_state_simulator_schedule(&simulator, 1, &first.machine, NULL,
+                                           go, (void *)&igniting) == 1);
+  assert(infinite_state_simulator_schedule(&simulator, 0, &first.machine, NULL,
+                                           go, NULL) == -ENOMEM);
+  assert(infinite_state_simulator_step(&simulator) == 1);
+  assert(infinite_state_machine_top(&first.machine) == &stopped);
+  assert(infinite_state_simulator_step(&simulator) == 1);
+  assert(infinite_state_machine_top(&first.machine) == &igniting);
+#ifdef INFINITE_STATE_ACTIVATIONS
+  /*
+   * A timeout armed in a state that the machine leaves and re-enters before
+   * expiry expires unfired; the re-entry arms its own.
+   */
+  static unsigned long activations[2];
+  struct infinite_state_simulator_event timeouts[4];
+  infinite_state_simulator_init(&simulator, timeouts, 4);
+  infinite_state_machine_init(&first.machine);
+  infinite_state_machine_activations(&first.machine, activations);
+  infinite_state_machine_goto(&first.machine, &stopped);
+  infinite_state_simulator_schedule(&simulator, 0, &first.machine, NULL, go,
+                                    (void *)&igniting);
+  infinite_state_simulator_schedule(&simulator, 1, &first.machine, NULL, go,
+                                    (void *)&stopped);
+  infinite_state_simulator_schedule(&simulator, 1, &first.machine, NULL, go,
+                                    (void *)&igniting);
+  assert(infinite_state_simulator_run(&simulator, 2) == 3);
+  assert(infinite_state_machine_top(&first.machine) == &igniting);
+  assert(infinite_state_simulator_run(&simulator, 3) == 1);
+  assert(infinite_state_machine_top(&first.machine) == &cranking);
+#endif
+  return 0;
+}